@@ -0,0 +1,39 @@
+// 80 instances per batch, keep in sync with InstanceBatcher::MAX_INSTANCES_PER_BATCH
+uniform vec4 worldMatrix3x4Array[240];
+uniform mat4 viewProjectionMatrix;
+uniform vec4 lightPosition;
+uniform vec4 lightDiffuse;
+uniform vec4 ambient;
+
+attribute vec4 blendIndices;
+
+void main()
+{
+	int idx = int(blendIndices.x) * 3;
+
+	// InstanceBatcher hides unused instances by giving them a zero scale; normalizing their
+	// normals would divide by zero, so they are put behind the far plane before that
+	vec3 row0 = worldMatrix3x4Array[idx].xyz;
+	vec3 row1 = worldMatrix3x4Array[idx + 1].xyz;
+	vec3 row2 = worldMatrix3x4Array[idx + 2].xyz;
+	if (dot(row0, row0) + dot(row1, row1) + dot(row2, row2) == 0.0)
+	{
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		gl_FrontColor = vec4(0.0);
+		gl_TexCoord[0] = vec4(0.0);
+		return;
+	}
+
+	vec4 worldPos = vec4(dot(worldMatrix3x4Array[idx], gl_Vertex),
+		dot(worldMatrix3x4Array[idx + 1], gl_Vertex),
+		dot(worldMatrix3x4Array[idx + 2], gl_Vertex), 1.0);
+	vec3 worldNormal = normalize(vec3(dot(row0, gl_Normal), dot(row1, gl_Normal), dot(row2, gl_Normal)));
+
+	// simple per vertex lighting with the first light, like the fixed function pipeline
+	vec3 lightDir = normalize(lightPosition.xyz - worldPos.xyz * lightPosition.w);
+	vec4 colour = ambient + lightDiffuse * max(dot(worldNormal, lightDir), 0.0);
+	gl_FrontColor = vec4(colour.rgb, 1.0);
+
+	gl_Position = viewProjectionMatrix * worldPos;
+	gl_TexCoord[0] = gl_MultiTexCoord0;
+}
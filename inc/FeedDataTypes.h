@@ -7,6 +7,8 @@
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
 #define foreach         BOOST_FOREACH
 #define reverse_foreach BOOST_REVERSE_FOREACH
 
@@ -16,13 +18,17 @@
  * - thread_event: same for the different threads
  * - input_mouse: all mouse input
  * - input_keyboard: all keypresses
- * - world_dynamic: position and orientation of all dynamic nodes: attention - only a pointer is passed as a update, upon recieving the data has to be copied!
+ * - world_dynamic: position and orientation of all dynamic nodes, stamped with the simulation time: attention - only a pointer is passed as a update, upon recieving the data has to be copied!
  * - world_static: same data for static objects, mostly geometry
  * - world_removed: ID of object that was removed, static or not
  * - create_object: objects which should be created (dynamic)
- * - create_terrain: same as create_object, but for terrain (which is static)
+ * - create_terrain: TerrainList with all static objects of a level, posted at once
+ * - level_loaded: boost::shared_ptr<LevelFile> of the level, posted before its objects
+ * - physics_capture: PhysicsStatePtr physics fills with the state of all dynamic bodies, done when the post returns
+ * - physics_restore: PhysicsStatePtr physics rewinds the simulation to, done when the post returns
  * - camera_position: CameraPosition telling the graphics engine  (and possible physics too) where to look at
  * - gui_event: everything that happens in the gui
+ * - resource_loaded: std::string name of a resource the ResourceManager finished loading, posted from its worker; graphics creates the objects and terrain waiting for it
  **/
 
 enum gui_event
@@ -209,6 +215,8 @@ struct InputMouseEvent
 	int mouseDeltaY;
 	input_action action;
 	input_mouse_type type;
+	/** monotonicTime() when the event was captured **/
+	double captured;
 };
 
 // Datatype for feed 'input_keyboard'
@@ -216,6 +224,8 @@ struct InputKeyboardEvent
 {
 	input_action action;
 	input_keyboard_type type;
+	/** monotonicTime() when the event was captured **/
+	double captured;
 };
 
 
@@ -247,6 +257,13 @@ struct Terrain
 	std::string specification;
 };
 
+// Datatype for feed 'create_terrain'
+typedef boost::shared_ptr< std::vector<Terrain> > TerrainList;
+
+class PhysicsState;
+// Datatype for feeds 'physics_capture' and 'physics_restore', see physicsstate.h
+typedef boost::shared_ptr<PhysicsState> PhysicsStatePtr;
+
 namespace boost {
 	namespace serialization {
 
@@ -266,71 +283,26 @@ namespace boost {
 	} // namespace serialization
 } // namespace boost
 
+/** position and orientation of one object **/
+struct Transform
+{
+	Transform() : pos(Ogre::Vector3::ZERO), orient(Ogre::Quaternion::IDENTITY) {}
+	Ogre::Vector3 pos;
+	Ogre::Quaternion orient;
+};
+
+/** Datatype for feed 'world_dynamic': transforms[i] belongs to the object ids[i].
+ * Both are plain arrays, copying a graph is two memcpys.
+ **/
 struct WorldGraph
 {
-	std::vector< OgreNewt::Node* > nodes;
-	void addNode(OgreNewt::Node* node) { nodes.push_back(node); }
-	WorldGraph() {}
-	WorldGraph(const WorldGraph& source)
-	{
-		if(!source.nodes.empty())
-		{
-			foreach(OgreNewt::Node* node, source.nodes)
-			{
-				this->nodes.push_back(new OgreNewt::Node(node));
-			}
-		}
-		
-	}
-	WorldGraph(const WorldGraph* source)
-	{
-		if(!source->nodes.empty())
-		{
-			foreach(OgreNewt::Node* node, source->nodes)
-			{
-				if(node != NULL)
-				{
-					this->nodes.push_back(new OgreNewt::Node(node));
-				}
-				else
-				{
-					Derr << "OgreNewt::Node with NULL-Pointer!";
-				}
-				
-			}
-		}
-		
-	}
-	WorldGraph& operator=(const WorldGraph& source)
-	{
-		// check for self-assignment  
-		if (this == &source)  
-			return *this;
-		
-		if(!nodes.empty())
-		{
-			foreach(OgreNewt::Node* node, nodes)
-			{
-				delete node;
-			}
-			nodes.clear();
-		}
-		if(!source.nodes.empty())
-		{
-			foreach(OgreNewt::Node* node, source.nodes)
-			{
-				this->nodes.push_back(new OgreNewt::Node(node));
-			}
-		}
-		return *this;  
-	}
-	~WorldGraph()
-	{
-		foreach(OgreNewt::Node* node, nodes)
-		{
-			delete node;
-		}
-	}
+	std::vector<int> ids;
+	std::vector<Transform> transforms;
+	/** simulation time in seconds this graph belongs to **/
+	double time;
+	WorldGraph() : time(0.0) {}
+	size_t size() const { return ids.size(); }
+	void clear() { ids.clear(); transforms.clear(); }
 };
 
 struct CameraPosition
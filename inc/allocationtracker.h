@@ -0,0 +1,162 @@
+//
+// C++ Interface: allocationtracker
+//
+// Description: Counts heap allocations per thread and per frame, and a frame arena for
+// data which only lives during one frame.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef ALLOCATIONTRACKER_H
+#define ALLOCATIONTRACKER_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+class Counter;
+class Histogram;
+
+struct AllocationCounts
+{
+	AllocationCounts() : allocations(0), deallocations(0), bytes(0) { }
+
+	AllocationCounts operator-(const AllocationCounts& earlier) const
+	{
+		AllocationCounts delta;
+		delta.allocations = allocations - earlier.allocations;
+		delta.deallocations = deallocations - earlier.deallocations;
+		delta.bytes = bytes - earlier.bytes;
+		return delta;
+	}
+
+	uint64_t allocations;
+	uint64_t deallocations;
+	/** allocated, frees aren't subtracted **/
+	uint64_t bytes;
+};
+
+/** everything the calling thread got from operator new since it started, reading it is free **/
+AllocationCounts threadAllocations();
+/** allocators of libraries which may allocate from threads of their own (Newton), all threads together **/
+AllocationCounts externalAllocations();
+void countExternalAllocation(size_t size);
+void countExternalDeallocation();
+
+/** Counts the allocations of one task per frame, between begin() and end(), into the
+ * histogram <name>_allocations_per_frame.
+ * Once the caller reported SETTLE_FRAMES settled frames in a row (nothing was added to or
+ * removed from the scene), every frame should reuse what the earlier ones allocated. In
+ * strict mode (--assert-no-allocations) one which doesn't is logged and fails an assertion.
+ * Only counts the calling thread, jobs it hands to the job system allocate on other threads.
+ **/
+class FrameAllocations
+{
+	public:
+		static const int SETTLE_FRAMES = 60;
+
+		/** external adds externalAllocations() to the frame, for tasks which run Newton **/
+		FrameAllocations(const std::string& name, bool external, bool strict);
+
+		void begin();
+		/** settled: the frame didn't change what the task keeps, so it must not have allocated **/
+		void end(bool settled);
+
+		/** frames which allocated after the scene had settled **/
+		uint64_t getViolations() const;
+
+	private:
+		AllocationCounts current();
+
+		std::string name;
+		bool external, strict;
+		Histogram* perFrame;
+		Counter* violations;
+		AllocationCounts started;
+		int settledFrames;
+};
+
+/** Bump allocator for data which is thrown away at the end of the frame: allocating moves a
+ * pointer, reset() forgets everything at once. If a frame needs more than the arena holds,
+ * the rest comes from the heap and the arena grows on the next reset(), so after a few frames
+ * it is big enough and doesn't allocate anymore.
+ * Belongs to one thread, like the frame it is used in.
+ **/
+class FrameArena
+{
+	public:
+		FrameArena(size_t capacity = 16 * 1024);
+		~FrameArena();
+
+		void* allocate(size_t size);
+		/** everything allocated since the last reset() is invalid afterwards **/
+		void reset();
+
+		size_t getCapacity() const { return capacity; }
+
+	private:
+		/** what operator new guarantees, enough for anything but SIMD types **/
+		static const size_t ALIGNMENT = 2 * sizeof(void*);
+
+		// not copyable
+		FrameArena(const FrameArena&);
+		FrameArena& operator=(const FrameArena&);
+
+		char* block;
+		size_t capacity;
+		size_t used;
+		/** heap blocks of this frame which didn't fit anymore **/
+		std::vector<void*> overflow;
+		size_t overflowBytes;
+};
+
+/** lets standard containers live in a FrameArena, deallocate does nothing; the container must
+ * be emptied before the arena is reset
+ **/
+template <class T>
+class ArenaAllocator
+{
+	public:
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+
+		template <class U>
+		struct rebind
+		{
+			typedef ArenaAllocator<U> other;
+		};
+
+		ArenaAllocator(FrameArena& arena) : arena(&arena) { }
+		template <class U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) { }
+
+		pointer address(reference x) const { return &x; }
+		const_pointer address(const_reference x) const { return &x; }
+		pointer allocate(size_type n, const void* = 0) { return static_cast<pointer>(arena->allocate(n * sizeof(T))); }
+		void deallocate(pointer, size_type) { }
+		size_type max_size() const { return size_t(-1) / sizeof(T); }
+		void construct(pointer p, const T& value) { new(static_cast<void*>(p)) T(value); }
+		void destroy(pointer p) { p->~T(); }
+
+		template <class U>
+		bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+		template <class U>
+		bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	private:
+		template <class U> friend class ArenaAllocator;
+
+		FrameArena* arena;
+};
+
+#endif
@@ -0,0 +1,115 @@
+//
+// C++ Interface: entitystore
+//
+// Description: Components of the objects a task knows about, stored in dense arrays
+// grouped by archetype, so systems can walk them in bulk.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef ENTITYSTORE_H
+#define ENTITYSTORE_H
+
+#include "FeedDataTypes.h"
+#include <stdint.h>
+#include <vector>
+#include <map>
+
+enum component_type
+{
+	/** Transform, what physics simulates and graphics draws **/
+	COMPONENT_TRANSFORM = 1 << 0,
+	/** Ogre::Vector3 **/
+	COMPONENT_SCALE = 1 << 1,
+	/** atom of the mesh name, see ObjectRegistry::intern **/
+	COMPONENT_SPECIFICATION = 1 << 2,
+	/** OgreNewt::Body* of a dynamic object **/
+	COMPONENT_BODY = 1 << 3,
+	/** index of the WorldShards shard the body lives in **/
+	COMPONENT_SHARD = 1 << 4,
+	/** RenderHandle **/
+	COMPONENT_RENDER = 1 << 5
+};
+
+typedef unsigned int ComponentMask;
+
+/** how graphics draws an entity: with its own scene node or as an instance in a batch **/
+struct RenderHandle
+{
+	RenderHandle() : node(NULL), instance(NULL), batch(NULL) {}
+	/** null if the entity is instanced **/
+	Ogre::SceneNode* node;
+	/** null unless the entity is instanced **/
+	Ogre::InstancedGeometry::InstancedObject* instance;
+	Ogre::InstancedGeometry::BatchInstance* batch;
+};
+
+/** All entities with exactly the same components. Every component has its own array, row i
+ * of each array belongs to ids[i]; arrays of components not in mask stay empty.
+ **/
+struct Archetype
+{
+	ComponentMask mask;
+	std::vector<int> ids;
+	std::vector<Transform> transforms;
+	std::vector<Ogre::Vector3> scales;
+	std::vector<uint32_t> specifications;
+	std::vector<OgreNewt::Body*> bodies;
+	std::vector<int> shards;
+	std::vector<RenderHandle> renderHandles;
+
+	size_t size() const { return ids.size(); }
+	bool has(ComponentMask components) const { return (mask & components) == components; }
+};
+
+/** Entities are the IDs handed out by the ObjectRegistry. Removing one moves the last row of
+ * its archetype into the hole, so the arrays never have gaps and rows aren't stable; IDs are.
+ * Not synchronised, every task owns its own store and only shares copies (like WorldGraph).
+ **/
+class EntityStore
+{
+	public:
+		EntityStore();
+		~EntityStore();
+
+		/** Gives ID exactly the components in mask. New components are zeroed, if ID was
+		 * there already the components it keeps are moved along. Returns the new row.
+		 **/
+		size_t add(int ID, ComponentMask mask);
+		void remove(int ID);
+		bool contains(int ID) const { return ID >= 0 && ID < (int)locations.size() && locations[ID].archetype >= 0; }
+
+		/** archetype and row of ID or null, only valid until the next add or remove; safe to call from several threads at once **/
+		Archetype* find(int ID, size_t& row) const;
+		/** every archetype having at least the components in mask, the pointers stay valid as long as the store **/
+		void query(ComponentMask mask, std::vector<Archetype*>& result) const;
+
+		size_t getEntityCount() const { return entityCount; }
+
+	private:
+		struct Location
+		{
+			Location() : archetype(-1), row(0) { }
+
+			int archetype;
+			size_t row;
+		};
+
+		Archetype* getArchetype(ComponentMask mask, int& index);
+		void eraseRow(int archetype, size_t row);
+
+		// not copyable
+		EntityStore(const EntityStore&);
+		EntityStore& operator=(const EntityStore&);
+
+		std::vector<Archetype*> archetypes;
+		std::map<ComponentMask, int> archetypeIndex;
+		/** indexed by ID, IDs are small and handed out in order **/
+		std::vector<Location> locations;
+		size_t entityCount;
+};
+
+#endif
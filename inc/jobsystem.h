@@ -0,0 +1,124 @@
+//
+// C++ Interface: jobsystem
+//
+// Description: Work-stealing pool of worker threads, sized to the machine, which
+// runs short jobs for all tasks.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include "singleton.h"
+#include <atomic>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/circular_buffer.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/** counts the unfinished jobs of one batch, JobSystem::wait() returns once it is zero **/
+class JobCounter
+{
+	public:
+		JobCounter() : pending(0) { }
+
+		bool done() const { return pending == 0; }
+
+	private:
+		friend class JobSystem;
+		std::atomic<int> pending;
+};
+
+/** Every worker owns a deque: jobs it submits itself go to the back and are taken from
+ * there again, while idle workers steal from the front of the others. Threads which aren't
+ * workers (the tasks) submit into a shared queue.
+ * A thread waiting for a JobCounter runs the queued jobs of that counter in the meantime, so
+ * jobs may submit and wait for sub-jobs themselves. It never runs unrelated jobs, those could
+ * need a lock the waiting thread holds. Workers without anything to do sleep, so CPU usage
+ * follows the actual amount of work.
+ * Jobs must not throw.
+ **/
+class JobSystem : public Singleton<JobSystem>
+{
+	public:
+		typedef boost::function<void ()> Job;
+		/** called with a half-open range [first, last) **/
+		typedef boost::function<void (size_t, size_t)> RangeJob;
+
+		/** starts one worker less than there are cores, the thread calling wait() is the last one **/
+		JobSystem();
+		~JobSystem();
+
+		/** queues job, counter (if given) is incremented now and decremented once job has run **/
+		void submit(const Job& job, JobCounter* counter = 0);
+		/** runs the jobs of counter which are still queued until it reaches zero **/
+		void wait(JobCounter& counter);
+		/** splits [begin, end) into chunks of at least grain elements, runs them in parallel
+		 * and returns once all are done; small ranges are run directly in the calling thread.
+		 * Doesn't allocate if body is small enough for boost::function to keep it inline
+		 * (a member function bound to an object and the two placeholders is).
+		 **/
+		void parallelFor(size_t begin, size_t end, size_t grain, const RangeJob& body);
+
+		int getWorkerCount() const { return workerCount; }
+		/** jobs waiting to be run, not counting the running ones **/
+		int getQueuedCount() const { return queued; }
+
+	private:
+		struct Entry
+		{
+			Job job;
+			JobCounter* counter;
+		};
+
+		/** a ring instead of a std::deque, which allocates and frees blocks while jobs pass through;
+		 * it only allocates when it has to grow
+		 **/
+		struct WorkQueue
+		{
+			WorkQueue() : jobs(256) { }
+
+			boost::mutex mutex;
+			boost::circular_buffer<Entry> jobs;
+		};
+
+		/** a parallelFor, its chunks only carry a pointer to it and their start **/
+		struct Range
+		{
+			const RangeJob* body;
+			size_t end;
+			size_t chunkSize;
+		};
+
+		void workerLoop(int index);
+		static void runChunk(const Range* range, size_t first);
+		/** runs one job from the own queue, the shared one or a victim, only one of counter if
+		 * that is given; returns false if there was none
+		 **/
+		bool runOne(const JobCounter* counter = 0);
+		bool pop(Entry& entry);
+		/** takes any queued job of counter, wherever it is **/
+		bool popJobOf(const JobCounter* counter, Entry& entry);
+		bool popBack(WorkQueue& queue, Entry& entry);
+		bool popFront(WorkQueue& queue, Entry& entry);
+
+		int workerCount;
+		/** index 0 is the shared queue, worker i owns queue i + 1 **/
+		std::vector<WorkQueue*> queues;
+		std::vector<boost::thread*> workers;
+
+		/** number of jobs in all queues, workers sleep while it is zero **/
+		std::atomic<int> queued;
+		std::atomic<unsigned int> nextVictim;
+		bool stopping;
+		boost::mutex sleepMutex;
+		boost::condition_variable workAvailable;
+};
+
+#endif
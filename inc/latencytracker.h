@@ -0,0 +1,73 @@
+//
+// C++ Interface: latencytracker
+//
+// Description: Percentiles of how long input events take to show an effect.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef LATENCYTRACKER_H
+#define LATENCYTRACKER_H
+
+#include "singleton.h"
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+/** Collects latency samples per stage (e.g. "input to present") from any thread and keeps
+ * the last WINDOW of each, so the percentiles follow the current threading mode and load.
+ * The kept samples are counted in BUCKETS logarithmic buckets, each 5% wider than the one
+ * before, so percentiles are read off a fixed histogram instead of sorting the samples and are
+ * exact to within a bucket. Neither adding samples nor summarising them allocates once a
+ * stage exists.
+ **/
+class LatencyTracker : public Singleton<LatencyTracker>
+{
+	public:
+		LatencyTracker() : sampleCount(0) { }
+
+		/** stage is compared by its text, it is copied when a stage is first seen **/
+		void addSample(const char* stage, double seconds);
+		/** one line per stage with p50 / p95 / p99 / max in ms over the kept samples, written
+		 * into text, which keeps its capacity from call to call
+		 **/
+		void summary(std::string& text);
+		std::string summary();
+		/** samples added so far, summary() only changes when this does **/
+		unsigned long getSampleCount();
+
+	private:
+		static const size_t WINDOW = 512;
+		static const size_t BUCKETS = 256;
+		/** upper bound of the first bucket in seconds, the last one goes to about 12s **/
+		static const double FIRST_BUCKET;
+		static const double BUCKET_GROWTH;
+
+		struct Stage
+		{
+			Stage(const char* name);
+
+			std::string name;
+			/** the bucket of each kept sample, to take it out of counts again once it is replaced **/
+			unsigned char window[WINDOW];
+			unsigned short counts[BUCKETS];
+			size_t next, kept;
+			unsigned long total;
+		};
+
+		static size_t bucketFor(double seconds);
+		/** upper bound of bucket in seconds **/
+		static double bucketBound(size_t bucket);
+		/** upper bound of the bucket holding the sample at fraction of the kept ones **/
+		static double percentile(const Stage& stage, double fraction);
+
+		/** few enough to be searched front to back **/
+		std::vector<Stage> stages;
+		unsigned long sampleCount;
+		boost::mutex mutex;
+};
+
+#endif
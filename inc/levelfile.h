@@ -0,0 +1,167 @@
+//
+// C++ Interface: levelfile
+//
+// Description: Binary level format, written by the level compiler (serializer) and
+// mapped straight into memory by the game.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef LEVELFILE_H
+#define LEVELFILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+struct Terrain;
+struct ObjectToCreate;
+namespace Ogre { class Vector3; }
+
+/** Layout of a level file, all in native byte order and 4 byte aligned:
+ * - LevelHeader
+ * - uint32_t offsets[stringCount], relative to the start of the string data
+ * - string data, every string NUL terminated
+ * - LevelPlacement placements[placementCount], the static objects
+ * - LevelPlacement spawns[spawnCount], the dynamic objects sorted by specification
+ * - LevelCollision collisions[collisionCount]
+ * - uint32_t resources[resourceCount], atoms of every mesh the level uses
+ * - blob data, the serialised Newton collisions
+ * Strings are stored once and referred to by their index (atom).
+ **/
+struct LevelHeader
+{
+	/** "OTEL" **/
+	char magic[4];
+	uint32_t version;
+	uint32_t stringCount;
+	uint32_t stringDataSize;
+	/** all offsets are in bytes from the start of the file **/
+	uint32_t placementCount, placementOffset;
+	uint32_t spawnCount, spawnOffset;
+	uint32_t collisionCount, collisionOffset;
+	uint32_t resourceCount, resourceOffset;
+	uint32_t blobDataSize, blobOffset;
+};
+
+/** one object, the same data as a Terrain or ObjectToCreate without its ID, which is assigned at runtime **/
+struct LevelPlacement
+{
+	float pos[3];
+	/** w, x, y, z like the Ogre::Quaternion constructor **/
+	float orient[4];
+	float scale[3];
+	/** atom of the mesh name **/
+	uint32_t specification;
+};
+
+enum level_collision_type
+{
+	/** static geometry **/
+	LEVEL_COLLISION_TREE,
+	/** dynamic objects **/
+	LEVEL_COLLISION_CONVEX_HULL
+};
+
+/** collision of one mesh at one scale, prebuilt by the level compiler **/
+struct LevelCollision
+{
+	uint32_t specification;
+	float scale[3];
+	uint32_t type;
+	/** position of the output of NewtonCollisionSerialize in the blob data **/
+	uint32_t offset, size;
+};
+
+/** Read only view of a level file. The file is mapped, not read, so opening it costs the
+ * same for any size and everything is used in place.
+ **/
+class LevelFile
+{
+	public:
+		static const uint32_t VERSION = 2;
+
+		LevelFile();
+		~LevelFile();
+
+		/** returns false if path can't be mapped or isn't a level of this VERSION, see getError() **/
+		bool open(const std::string& path);
+		void close();
+		const std::string& getError() const { return error; }
+
+		uint32_t getStringCount() const { return header->stringCount; }
+		const char* getString(uint32_t atom) const { return strings + offsets[atom]; }
+
+		uint32_t getPlacementCount() const { return header->placementCount; }
+		const LevelPlacement& getPlacement(uint32_t i) const { return placements[i]; }
+		/** fills terrain with placement i, the ID is left alone **/
+		void getTerrain(uint32_t i, Terrain& terrain) const;
+
+		uint32_t getSpawnCount() const { return header->spawnCount; }
+		const LevelPlacement& getSpawn(uint32_t i) const { return spawns[i]; }
+		/** fills object with spawn i, the ID is left alone **/
+		void getObject(uint32_t i, ObjectToCreate& object) const;
+
+		uint32_t getResourceCount() const { return header->resourceCount; }
+		const char* getResource(uint32_t i) const { return getString(resources[i]); }
+
+		/** looks up the prebuilt collision of specification at scale, returns false if there is none **/
+		bool findCollision(const std::string& specification, const Ogre::Vector3& scale, level_collision_type type, const void*& blob, size_t& blobSize) const;
+
+	private:
+		// not copyable, the mapping is owned
+		LevelFile(const LevelFile&);
+		LevelFile& operator=(const LevelFile&);
+
+		bool fail(const std::string& why);
+		/** true if count elements of elementSize fit into the file at offset **/
+		bool fits(uint32_t offset, uint32_t count, size_t elementSize) const;
+
+		void* data;
+		size_t size;
+		const LevelHeader* header;
+		const uint32_t* offsets;
+		const char* strings;
+		const LevelPlacement* placements;
+		const LevelPlacement* spawns;
+		const LevelCollision* collisions;
+		const uint32_t* resources;
+		const char* blobs;
+		std::string error;
+};
+
+/** builds a level in memory and writes it in the format LevelFile reads **/
+class LevelWriter
+{
+	public:
+		/** returns the atom of name, adding it to the string table if it isn't there yet **/
+		uint32_t intern(const std::string& name);
+		void addPlacement(const Terrain& terrain);
+		void addSpawn(const Terrain& object);
+		void addCollision(const std::string& specification, const Ogre::Vector3& scale, level_collision_type type, const std::vector<char>& blob);
+
+		size_t getPlacementCount() const { return placements.size(); }
+		size_t getSpawnCount() const { return spawns.size(); }
+		size_t getCollisionCount() const { return collisions.size(); }
+
+		/** sorts the spawns by specification, so objects which can share an instance batch arrive together **/
+		bool write(const std::string& path);
+
+	private:
+		LevelPlacement pack(const Terrain& terrain);
+
+		std::vector<std::string> strings;
+		std::map<std::string, uint32_t> atoms;
+		std::vector<LevelPlacement> placements;
+		std::vector<LevelPlacement> spawns;
+		std::vector<LevelCollision> collisions;
+		std::vector<char> blobData;
+		/** every specification used by a placement or spawn, in the order first seen **/
+		std::vector<uint32_t> resources;
+};
+
+#endif
@@ -0,0 +1,114 @@
+//
+// C++ Interface: metrics
+//
+// Description: Counters, gauges and histograms which are updated by the tasks and can be
+// read while the engine runs.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "singleton.h"
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/thread/mutex.hpp>
+
+/** only ever goes up, e.g. the number of frames rendered **/
+class Counter
+{
+	public:
+		Counter() : value(0) { }
+
+		void add(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+		uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<uint64_t> value;
+};
+
+/** the current value of something, e.g. the length of a queue **/
+class Gauge
+{
+	public:
+		Gauge() : value(0.0) { }
+
+		void set(double current) { value.store(current, std::memory_order_relaxed); }
+		double get() const { return value.load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<double> value;
+};
+
+/** counts observations into buckets with fixed upper bounds, e.g. frame times **/
+class Histogram
+{
+	public:
+		/** bounds have to be ascending, everything above the last one goes into an overflow bucket **/
+		Histogram(const std::vector<double>& bounds);
+
+		void observe(double value);
+
+		const std::vector<double>& getBounds() const { return bounds; }
+		/** observations in bucket i (not cumulative), i == getBounds().size() is the overflow bucket **/
+		uint64_t getBucket(size_t i) const { return buckets[i].load(std::memory_order_relaxed); }
+		uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+		double getSum() const { return sum.load(std::memory_order_relaxed); }
+		/** upper bound of the bucket containing quantile q (0..1), infinity if it is the overflow bucket **/
+		double getQuantile(double q) const;
+
+		/** count bounds, starting at first and growing by factor **/
+		static std::vector<double> exponentialBounds(double first, double factor, int count);
+
+	private:
+		std::vector<double> bounds;
+		std::vector< std::atomic<uint64_t> > buckets;
+		std::atomic<uint64_t> count;
+		std::atomic<double> sum;
+};
+
+/** Registry of all metrics, by name. Looking a metric up takes a lock, so tasks do it once and
+ * keep the reference; updating it afterwards is a single atomic operation. Metrics live as
+ * long as the registry.
+ * exposition() renders everything in the Prometheus text format, summary() in a few lines
+ * for the debug overlay.
+ **/
+class Metrics : public Singleton<Metrics>
+{
+	public:
+		~Metrics();
+
+		/** names follow Prometheus conventions: lower case, units as suffix, _total for counters **/
+		Counter& counter(const std::string& name, const std::string& help);
+		Gauge& gauge(const std::string& name, const std::string& help);
+		/** bounds are only used if name isn't registered yet **/
+		Histogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds);
+
+		std::string exposition();
+		std::string summary();
+		/** writes exposition() to path, replacing the file at once so readers never see half of it **/
+		bool writeFile(const std::string& path);
+
+	private:
+		struct Entry
+		{
+			Entry() : counter(0), gauge(0), histogram(0) { }
+
+			std::string help;
+			Counter* counter;
+			Gauge* gauge;
+			Histogram* histogram;
+		};
+
+		std::map<std::string, Entry> entries;
+		boost::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,107 @@
+//
+// C++ Interface: mpscqueue
+//
+// Description: Lock-free queue for many producer threads and a single consumer.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+/** Intrusive MPSC queue after Dmitry Vyukov: push() is wait-free and may be called from
+ * any thread, pop() must only be called from one thread at a time.
+ * A push which is still in progress can make pop() return false for a moment even though
+ * the queue isn't empty, the element is simply returned by a later pop().
+ **/
+template<typename T> class MPSCQueue
+{
+	public:
+		MPSCQueue() : head(&stub), tail(&stub), count(0)
+		{
+			stub.next = 0;
+		}
+
+		~MPSCQueue()
+		{
+			T value;
+			while(pop(value)) { }
+		}
+
+		void push(const T& value)
+		{
+			Node* node = new Node;
+			node->value = value;
+			node->next = 0;
+			count++;
+			enqueue(node);
+		}
+
+		bool pop(T& value)
+		{
+			Node* current = tail;
+			Node* next = current->next;
+
+			// skip the stub, it is put back at the end once the queue runs empty
+			if(current == &stub)
+			{
+				if(next == 0)
+					return false;
+				tail = next;
+				current = next;
+				next = next->next;
+			}
+
+			if(next == 0)
+			{
+				// current is the last node, unless a producer is just appending to it
+				if(current != head)
+					return false;
+				enqueue(&stub);
+				next = current->next;
+				if(next == 0)
+					return false;
+			}
+
+			tail = next;
+			value = current->value;
+			delete current;
+			count--;
+			return true;
+		}
+
+		/** number of elements pushed but not yet popped, only approximate while producers are active **/
+		size_t size() const { return count; }
+
+	private:
+		struct Node
+		{
+			std::atomic<Node*> next;
+			T value;
+		};
+
+		void enqueue(Node* node)
+		{
+			node->next = 0;
+			Node* previous = head.exchange(node);
+			previous->next = node;
+		}
+
+		// not copyable
+		MPSCQueue(const MPSCQueue&);
+		MPSCQueue& operator=(const MPSCQueue&);
+
+		Node stub;
+		std::atomic<Node*> head;
+		/** only touched by the consumer **/
+		Node* tail;
+		std::atomic<size_t> count;
+};
+
+#endif
@@ -13,20 +13,36 @@
 #define OBJECTREGISTRY_H
 
 #include "singleton.h"
+#include <stdint.h>
 #include <string>
 #include <map>
+#include <deque>
+#include <vector>
+#include <boost/thread/mutex.hpp>
 
+/** Hands out object IDs and keeps the name of every object. Names are interned: each
+ * distinct string is stored once and can be referred to by its atom, which is what
+ * EntityStores keep as specification. Can be used from any thread.
+ **/
 class ObjectRegistry : public Singleton<ObjectRegistry>
 {
 	public:
 		int addObject(const std::string& name);
 		const std::string& getNameForID(int id);
+		/** returns the atom of name, adding name if it wasn't seen before **/
+		uint32_t intern(const std::string& name);
+		const std::string& getString(uint32_t atom);
 		ObjectRegistry();
 		~ObjectRegistry() {}
 	private:
-		int objectIDCounter;
-		std::map<int, std::string> objects;
+		/** atom of the name of every object, indexed by ID; ID 0 is never handed out **/
+		std::vector<uint32_t> objects;
+		/** a deque, so the references getString returns stay valid while strings are added **/
+		std::deque<std::string> strings;
+		std::map<std::string, uint32_t> atoms;
+		boost::mutex mutex;
 
+		uint32_t internLocked(const std::string& name);
 };
 
 #endif
@@ -0,0 +1,77 @@
+//
+// C++ Interface: physicsstate
+//
+// Description: Captures the state of all dynamic bodies into one buffer and puts it
+// back, to rewind the simulation.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#ifndef PHYSICSSTATE_H
+#define PHYSICSSTATE_H
+
+#include "OgreNewt.h"
+#include "entitystore.h"
+
+#include <vector>
+
+/** Everything Newton needs to continue simulating the dynamic bodies from one moment on:
+ * matrix, velocity, omega, whether they sleep, are frozen or may fall asleep on their own,
+ * keyed by the ObjectRegistry ID of their entity. Joints are not stored, Newton derives their
+ * state from the matrices of the bodies they connect; contacts are found again by the next step.
+ * Capturing again reuses the buffer, so keeping a few states around for rollback doesn't
+ * allocate once they are filled. Neither capture nor restore may run during a step, the
+ * physics task does both when asked on the feeds physics_capture and physics_restore.
+ **/
+class PhysicsState
+{
+	public:
+		struct BodyState
+		{
+			int ID;
+			/** Newton put the body to sleep because it came to rest, a contact wakes it again **/
+			int sleeping;
+			/** a frozen body stays where it is until it is unfrozen explicitly **/
+			int frozen;
+			int autoSleep;
+			float matrix[16];
+			float velocity[3];
+			float omega[3];
+		};
+
+		PhysicsState() : time(0.0) {}
+
+		/** replaces the stored state with that of every entity with COMPONENT_BODY, time is the
+		 * simulation time it belongs to
+		 **/
+		void capture(const EntityStore& entities, double time = 0.0);
+		/** Puts the stored state back into the bodies of the same IDs, whichever shard they are in
+		 * now; a body which migrated is moved back by the next update. Bodies which are exactly as
+		 * captured, like most sleeping ones, are left alone. Entities created after the capture
+		 * are not touched. Returns the number of captured IDs which have no body anymore.
+		 **/
+		size_t restore(EntityStore& entities) const;
+
+		/** whether both hold the same bodies in the same state, bit for bit **/
+		bool equals(const PhysicsState& other) const;
+
+		/** simulation time passed to capture **/
+		double getTime() const { return time; }
+		size_t size() const { return bodies.size(); }
+		bool empty() const { return bodies.empty(); }
+		/** size of the buffer in bytes **/
+		size_t getMemoryUsed() const { return bodies.capacity() * sizeof(BodyState); }
+
+	private:
+		/** in the order of the entity store, so restoring walks both front to back **/
+		std::vector<BodyState> bodies;
+		double time;
+		/** reused by capture **/
+		std::vector<Archetype*> archetypes;
+};
+
+#endif
@@ -0,0 +1,94 @@
+//
+// C++ Interface: profiler
+//
+// Description: Scoped timing zones on all threads, exported as a Chrome trace.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "singleton.h"
+#include "timer.h"
+#include <atomic>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+/** Every thread records the zones it leaves into its own ring of the last CAPACITY zones,
+ * without locks; only the first zone of a thread takes the mutex to register its ring.
+ * writeChromeTrace() copies all rings while they are being written and drops what was
+ * overwritten meanwhile, so it can be called at any time from any thread. Load the file in
+ * chrome://tracing, zones nested in the same thread show up as a hierarchy.
+ **/
+class Profiler : public Singleton<Profiler>
+{
+	public:
+		static const size_t CAPACITY = 1 << 16;
+
+		Profiler();
+		~Profiler();
+
+		/** name must be a string literal (or live as long as the profiler), only the pointer is kept **/
+		void addZone(const char* name, double start, double end);
+		/** name of the calling thread in the trace **/
+		void nameThread(const std::string& name);
+		/** returns false if path can't be written **/
+		bool writeChromeTrace(const std::string& path);
+
+	private:
+		struct Zone
+		{
+			std::atomic<const char*> name;
+			std::atomic<double> start, end;
+		};
+
+		/** written by its thread only **/
+		struct ThreadBuffer
+		{
+			ThreadBuffer(int id) : id(id), begun(0), written(0), zones(CAPACITY) { }
+
+			int id;
+			std::string name;
+			/** number of zones whose slot is being or was written, bumped before the slot **/
+			std::atomic<size_t> begun;
+			/** number of zones completely written, bumped after the slot **/
+			std::atomic<size_t> written;
+			std::vector<Zone> zones;
+		};
+
+		ThreadBuffer* getBuffer();
+
+		/** start of the trace, all timestamps are relative to it **/
+		double started;
+		std::vector<ThreadBuffer*> buffers;
+		/** guards buffers and the names in them **/
+		boost::mutex mutex;
+};
+
+/** times the scope it lives in **/
+class ProfileZone
+{
+	public:
+		ProfileZone(const char* name) : name(name), start(monotonicTime()) { }
+		~ProfileZone() { Profiler::Instance().addZone(name, start, monotonicTime()); }
+
+	private:
+		const char* name;
+		double start;
+};
+
+#define PROFILE_CONCAT2(a, b) a ## b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#ifdef NO_PROFILER
+#define PROFILE_ZONE(name)
+#else
+/** PROFILE_ZONE("physics update") times the rest of the enclosing scope **/
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+#endif
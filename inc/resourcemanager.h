@@ -1,7 +1,7 @@
 //
 // C++ Interface: resourcemanager
 //
-// Description: 
+// Description:
 //
 //
 // Author:  <>, (C) 2009
@@ -15,13 +15,89 @@
 #include <taskengine/taskengine.h>
 #include "singleton.h"
 #include <map>
+#include <queue>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
+enum resource_priority
+{
+	RESOURCE_PRIORITY_LOW = 0,
+	RESOURCE_PRIORITY_NORMAL = 50,
+	RESOURCE_PRIORITY_HIGH = 100
+};
+
+/** handle to a resource which is loaded in the background, shared by everyone who requested it **/
+class ResourceRequest
+{
+	public:
+		ResourceRequest(const std::string& name) : name(name), ready(false), started(false) { }
+
+		const std::string& getName() const { return name; }
+		bool isReady() const;
+		/** blocks until the resource is loaded **/
+		DataContainer wait();
+
+	private:
+		friend class ResourceManager;
+		void complete(const DataContainer& result);
+
+		std::string name;
+		DataContainer data;
+		bool ready;
+		/** set once a worker picked the request up, guarded by the ResourceManager **/
+		bool started;
+		mutable boost::mutex mutex;
+		boost::condition_variable loaded;
+};
+
+typedef boost::shared_ptr<ResourceRequest> ResourceHandle;
+
+/** Loads resources on a small pool of worker threads, higher priorities first.
+ * Every resource is loaded only once, later requests get the same handle.
+ * Finished resources are announced on the resource_loaded feed with their name.
+ **/
 class ResourceManager : public Singleton<ResourceManager>
 {
 	public:
+		ResourceManager();
+		~ResourceManager();
+
+		/** returns immediately, requesting a queued resource again with a higher priority moves it up **/
+		ResourceHandle requestResource(const std::string& name, int priority = RESOURCE_PRIORITY_NORMAL);
+		/** blocks until name is loaded **/
 		DataContainer loadResource(const std::string& name);
+
 	private:
-		std::map<std::string, DataContainer> resources;
+		struct QueueEntry
+		{
+			ResourceHandle request;
+			int priority;
+			/** keeps requests of the same priority in order **/
+			unsigned int sequence;
+
+			bool operator<(const QueueEntry& other) const
+			{
+				if(priority != other.priority)
+					return priority < other.priority;
+				return sequence > other.sequence;
+			}
+		};
+
+		void workerLoop();
+		DataContainer load(const std::string& name);
+
+		static const int WORKER_COUNT = 2;
+
+		std::map<std::string, ResourceHandle> resources;
+		std::priority_queue<QueueEntry> queue;
+		unsigned int sequence;
+		bool stopping;
+
+		boost::mutex mutex;
+		boost::condition_variable workAvailable;
+		boost::thread_group workers;
 };
 
 #endif
@@ -0,0 +1,61 @@
+//
+// C++ Interface: startupprofiler
+//
+// Description: Times the phases of engine startup, on all threads.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include "singleton.h"
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+/** Collects the start and duration of every startup phase, relative to the moment it was
+ * first used (the start of main). report() logs the breakdown once the main menu is reached.
+ * Times come from the monotonic clock, adjusting the wall clock during startup doesn't skew them.
+ **/
+class StartupProfiler : public Singleton<StartupProfiler>
+{
+	public:
+		StartupProfiler();
+
+		/** seconds since the profiler was created **/
+		double now() const;
+		void addPhase(const std::string& name, double start, double duration);
+		/** logs all phases ordered by their start, only the first call does anything **/
+		void report();
+
+	private:
+		struct Phase
+		{
+			std::string name;
+			double start, duration;
+		};
+
+		/** monotonicTime() when the profiler was created **/
+		double started;
+		std::vector<Phase> phases;
+		bool reported;
+		boost::mutex mutex;
+};
+
+/** times the scope it lives in as one startup phase **/
+class StartupPhase
+{
+	public:
+		StartupPhase(const std::string& name) : name(name), start(StartupProfiler::Instance().now()) { }
+		~StartupPhase() { StartupProfiler::Instance().addPhase(name, start, StartupProfiler::Instance().now() - start); }
+
+	private:
+		std::string name;
+		double start;
+};
+
+#endif
@@ -1,11 +1,26 @@
+#ifndef TIMER_H
+#define TIMER_H
+
 #include "boost/date_time/posix_time/posix_time.hpp"
+#include <chrono>
+
+/** seconds on a monotonic clock, only differences between two calls mean something **/
+inline double monotonicTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
+/** measures seconds since it was created or reset, on the monotonic clock so it is neither
+ * affected by clock changes nor by midnight
+ **/
 class Timer
 {
 	public:
-		Timer() : started( boost::posix_time::microsec_clock::local_time() ) {}
-		double time() { return (boost::posix_time::microsec_clock::local_time().time_of_day() - started.time_of_day()).total_nanoseconds() / 1000000000.0; }
-		void reset() { started = boost::posix_time::microsec_clock::local_time(); }
+		Timer() : started( monotonicTime() ) {}
+		double time() { return monotonicTime() - started; }
+		void reset() { started = monotonicTime(); }
 	private:
-		boost::posix_time::ptime started;
-};
\ No newline at end of file
+		double started;
+};
+
+#endif
@@ -0,0 +1,61 @@
+//
+// C++ Interface: wakeupsignal
+//
+// Description: Lets a task sleep until another thread has work for it.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#ifndef WAKEUPSIGNAL_H
+#define WAKEUPSIGNAL_H
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+/** Auto-resetting event: notify() wakes the waiting thread, or the next one to wait if
+ * nobody is waiting right now, so a notification is never lost.
+ **/
+class WakeupSignal
+{
+	public:
+		WakeupSignal() : signalled(false) { }
+
+		void notify()
+		{
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				signalled = true;
+			}
+			wakeup.notify_one();
+		}
+
+		/** blocks until notified or seconds have passed, returns false on timeout **/
+		bool waitFor(double seconds)
+		{
+			boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds((long)(seconds * 1000000.0));
+			boost::mutex::scoped_lock lock(mutex);
+
+			while(!signalled)
+			{
+				if(!wakeup.timed_wait(lock, deadline))
+				{
+					break;
+				}
+			}
+
+			bool woken = signalled;
+			signalled = false;
+			return woken;
+		}
+
+	private:
+		bool signalled;
+		boost::mutex mutex;
+		boost::condition_variable wakeup;
+};
+
+#endif
@@ -0,0 +1,258 @@
+//
+// C++ Implementation: allocationtracker
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "allocationtracker.h"
+#include "metrics.h"
+#include <taskengine/taskengine.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+
+const int FrameAllocations::SETTLE_FRAMES;
+const size_t FrameArena::ALIGNMENT;
+
+// plain thread locals, the hooks below run before anything else is set up
+static __thread uint64_t threadAllocationCount = 0;
+static __thread uint64_t threadDeallocationCount = 0;
+static __thread uint64_t threadAllocatedBytes = 0;
+
+static std::atomic<uint64_t> externalAllocationCount(0);
+static std::atomic<uint64_t> externalDeallocationCount(0);
+static std::atomic<uint64_t> externalAllocatedBytes(0);
+
+static void* countedAlloc(size_t size)
+{
+	threadAllocationCount++;
+	threadAllocatedBytes += size;
+	// new has to return a unique pointer even for 0 bytes
+	return std::malloc(size ? size : 1);
+}
+
+static void countedFree(void* ptr)
+{
+	if(ptr)
+	{
+		threadDeallocationCount++;
+		std::free(ptr);
+	}
+}
+
+// has to match the declaration in <new>, which lost its exception specification in C++11
+#if __cplusplus >= 201103L
+#define THROWS_BAD_ALLOC
+#else
+#define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#endif
+
+// every allocation of the program, including those of the libraries, goes through these
+void* operator new(size_t size) THROWS_BAD_ALLOC
+{
+	void* ptr = countedAlloc(size);
+	if(!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size) THROWS_BAD_ALLOC
+{
+	void* ptr = countedAlloc(size);
+	if(!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void* ptr) throw()
+{
+	countedFree(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+	countedFree(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) throw()
+{
+	countedFree(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) throw()
+{
+	countedFree(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, size_t) throw()
+{
+	countedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t) throw()
+{
+	countedFree(ptr);
+}
+#endif
+
+AllocationCounts threadAllocations()
+{
+	AllocationCounts counts;
+	counts.allocations = threadAllocationCount;
+	counts.deallocations = threadDeallocationCount;
+	counts.bytes = threadAllocatedBytes;
+	return counts;
+}
+
+AllocationCounts externalAllocations()
+{
+	AllocationCounts counts;
+	counts.allocations = externalAllocationCount.load(std::memory_order_relaxed);
+	counts.deallocations = externalDeallocationCount.load(std::memory_order_relaxed);
+	counts.bytes = externalAllocatedBytes.load(std::memory_order_relaxed);
+	return counts;
+}
+
+void countExternalAllocation(size_t size)
+{
+	externalAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	externalAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void countExternalDeallocation()
+{
+	externalDeallocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameAllocations::FrameAllocations(const std::string& name, bool external, bool strict) : name(name), external(external), strict(strict), settledFrames(0)
+{
+	// zero gets a bucket of its own, that's what a settled frame should show
+	std::vector<double> bounds(1, 0.0);
+	std::vector<double> growing = Histogram::exponentialBounds(1.0, 4.0, 6);
+	bounds.insert(bounds.end(), growing.begin(), growing.end());
+
+	Metrics& metrics = Metrics::Instance();
+	perFrame = &metrics.histogram(name + "_allocations_per_frame", "Heap allocations of one " + name + " frame", bounds);
+	violations = &metrics.counter(name + "_settled_frames_allocating_total", name + " frames which allocated although the scene had settled");
+}
+
+uint64_t FrameAllocations::getViolations() const
+{
+	return violations->get();
+}
+
+AllocationCounts FrameAllocations::current()
+{
+	AllocationCounts counts = threadAllocations();
+	if(external)
+	{
+		AllocationCounts other = externalAllocations();
+		counts.allocations += other.allocations;
+		counts.deallocations += other.deallocations;
+		counts.bytes += other.bytes;
+	}
+	return counts;
+}
+
+void FrameAllocations::begin()
+{
+	started = current();
+}
+
+void FrameAllocations::end(bool settled)
+{
+	AllocationCounts frame = current() - started;
+	perFrame->observe(frame.allocations);
+
+	if(!settled)
+	{
+		settledFrames = 0;
+		return;
+	}
+	if(settledFrames < SETTLE_FRAMES)
+	{
+		// containers are still growing to the size of the new scene
+		settledFrames++;
+		return;
+	}
+
+	if(frame.allocations > 0)
+	{
+		violations->add();
+		if(strict)
+		{
+			Derr << name << " allocated " << frame.allocations << " times (" << frame.bytes << " bytes) in a frame after the scene had settled";
+			assert(frame.allocations == 0);
+		}
+	}
+}
+
+FrameArena::FrameArena(size_t capacity) : block(static_cast<char*>(::operator new(capacity))), capacity(capacity), used(0), overflowBytes(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	for(size_t i = 0; i < overflow.size(); i++)
+	{
+		::operator delete(overflow[i]);
+	}
+	::operator delete(block);
+}
+
+void* FrameArena::allocate(size_t size)
+{
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	if(used + size <= capacity)
+	{
+		void* ptr = block + used;
+		used += size;
+		return ptr;
+	}
+
+	// counted like any other allocation, the arena is too small for this frame
+	void* ptr = ::operator new(size);
+	overflow.push_back(ptr);
+	overflowBytes += size;
+	return ptr;
+}
+
+void FrameArena::reset()
+{
+	if(!overflow.empty())
+	{
+		for(size_t i = 0; i < overflow.size(); i++)
+		{
+			::operator delete(overflow[i]);
+		}
+		overflow.clear();
+
+		// big enough for the whole frame next time
+		::operator delete(block);
+		capacity = std::max(capacity * 2, used + overflowBytes);
+		block = static_cast<char*>(::operator new(capacity));
+		overflowBytes = 0;
+	}
+	used = 0;
+}
@@ -0,0 +1,160 @@
+//
+// C++ Implementation: converterbench
+//
+// Description: Compares OgreNewt's batch converters against calling the scalar
+// converters once per body.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "Ogre.h"
+#include "OgreNewt.h"
+#include "OgreNewt_BatchConverters.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+
+using namespace OgreNewt::Converters;
+
+/** runs func repeatedly for about half a second and returns the nanoseconds per element **/
+template<class Func>
+double measure(Func func, size_t elements)
+{
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	boost::posix_time::time_duration elapsed;
+	long runs = 0;
+	do
+	{
+		func();
+		++runs;
+		elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+	} while (elapsed.total_milliseconds() < 500);
+
+	return elapsed.total_nanoseconds() / double(runs * elements);
+}
+
+void report(const std::string& name, double scalar, double batch)
+{
+	std::cout << std::setw(18) << std::left << name
+	          << std::setw(10) << std::right << std::fixed << std::setprecision(2) << scalar << " ns"
+	          << std::setw(10) << batch << " ns"
+	          << std::setw(8) << std::setprecision(1) << scalar / batch << "x" << std::endl;
+}
+
+/** Converts quats to matrices and back with the batch converters and checks that the rebuilt
+ * matrices match, returns the number of quaternions which didn't survive. Covers 180 degree
+ * rotations about axes which aren't principal, where w is 0 and the signs are hardest to get.
+ **/
+size_t verify()
+{
+	const Ogre::Real axes[][3] = { {0, 1, -1}, {1, 1, 1}, {1, -2, 3}, {-1, 0, 1}, {1, 1, 0}, {3, -1, -2}, {0.2, -0.9, 0.4}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1} };
+	const Ogre::Real angles[] = { Ogre::Math::PI, Ogre::Math::PI - 1e-4, Ogre::Math::PI + 1e-4, Ogre::Math::HALF_PI, 0.3, Ogre::Math::TWO_PI - 0.01, 0.0 };
+
+	std::vector<Ogre::Quaternion> quats;
+	for (size_t i = 0; i < sizeof(axes) / sizeof(axes[0]); i++)
+	{
+		for (size_t j = 0; j < sizeof(angles) / sizeof(angles[0]); j++)
+		{
+			Ogre::Vector3 axis(axes[i][0], axes[i][1], axes[i][2]);
+			axis.normalise();
+			quats.push_back(Ogre::Quaternion(Ogre::Radian(angles[j]), axis));
+		}
+	}
+	// the batches are handled 4 and 8 at a time, the rest goes to the scalar code
+	while (quats.size() % 8 != 0)
+	{
+		quats.push_back(Ogre::Quaternion::IDENTITY);
+	}
+
+	size_t count = quats.size();
+	std::vector<Ogre::Vector3> positions(count, Ogre::Vector3(1, 2, 3)), positionsBack(count);
+	std::vector<Ogre::Quaternion> quatsBack(count);
+	std::vector<float> matrices(count * 16), matricesBack(count * 16);
+
+	QuatPosToMatrixBatch(&quats[0], &positions[0], &matrices[0], count);
+	MatrixToQuatPosBatch(&matrices[0], &quatsBack[0], &positionsBack[0], count);
+	QuatPosToMatrixBatch(&quatsBack[0], &positionsBack[0], &matricesBack[0], count);
+
+	size_t failed = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (size_t k = 0; k < 16; k++)
+		{
+			if (Ogre::Math::Abs(matrices[i*16 + k] - matricesBack[i*16 + k]) > 1e-4)
+			{
+				std::cout << "MatrixToQuatPos " << quats[i] << " came back as " << quatsBack[i] << std::endl;
+				failed++;
+				break;
+			}
+		}
+	}
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t count = 10000;
+	if (argc > 1)
+	{
+		count = boost::lexical_cast<size_t>(argv[1]);
+	}
+
+	std::vector<Ogre::Quaternion> quats(count);
+	std::vector<Ogre::Vector3> positions(count);
+	std::vector<Ogre::Matrix4> ogreMatrices(count);
+	std::vector<float> matrices(count * 16);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Ogre::Vector3 axis(rand() - RAND_MAX / 2, rand() - RAND_MAX / 2, rand() - RAND_MAX / 2);
+		axis.normalise();
+		quats[i].FromAngleAxis(Ogre::Radian(Ogre::Math::RangeRandom(0.0, Ogre::Math::TWO_PI)), axis);
+		positions[i] = Ogre::Vector3(Ogre::Math::RangeRandom(-1000, 1000), Ogre::Math::RangeRandom(-1000, 1000), Ogre::Math::RangeRandom(-1000, 1000));
+		ogreMatrices[i].makeTransform(positions[i], Ogre::Vector3::UNIT_SCALE, quats[i]);
+	}
+
+	// the numbers mean nothing if the fast path is wrong
+	size_t failed = verify();
+	setBatchConverterScalar(true);
+	failed += verify();
+	setBatchConverterScalar(false);
+	if (failed > 0)
+	{
+		std::cout << failed << " conversions failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << count << " elements, batch converters use " << getBatchConverterPath() << std::endl;
+	std::cout << std::setw(18) << std::left << "" << std::setw(13) << std::right << "scalar" << std::setw(13) << "batch" << std::endl;
+
+	double scalar = measure([&]() {
+		for (size_t i = 0; i < count; i++)
+			QuatPosToMatrix(quats[i], positions[i], &matrices[i*16]);
+	}, count);
+	double batch = measure([&]() { QuatPosToMatrixBatch(&quats[0], &positions[0], &matrices[0], count); }, count);
+	report("QuatPosToMatrix", scalar, batch);
+
+	scalar = measure([&]() {
+		for (size_t i = 0; i < count; i++)
+			MatrixToQuatPos(&matrices[i*16], quats[i], positions[i]);
+	}, count);
+	batch = measure([&]() { MatrixToQuatPosBatch(&matrices[0], &quats[0], &positions[0], count); }, count);
+	report("MatrixToQuatPos", scalar, batch);
+
+	scalar = measure([&]() {
+		for (size_t i = 0; i < count; i++)
+			Matrix4ToMatrix(ogreMatrices[i], &matrices[i*16]);
+	}, count);
+	batch = measure([&]() { Matrix4ToMatrixBatch(&ogreMatrices[0], &matrices[0], count); }, count);
+	report("Matrix4ToMatrix", scalar, batch);
+
+	return EXIT_SUCCESS;
+}
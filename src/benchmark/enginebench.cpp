@@ -0,0 +1,432 @@
+//
+// C++ Implementation: enginebench
+//
+// Description: Microbenchmarks of the engine's hot paths at 1k, 10k and 100k objects:
+// snapshot copies, feeds, the object registry, converters, interpolation and lookups.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "Ogre.h"
+#include "OgreNewt.h"
+#include "OgreNewt_BatchConverters.h"
+#include <taskengine/taskengine.h>
+#include "FeedDataTypes.h"
+#include "allocationtracker.h"
+#include "entitystore.h"
+#include "objectregistry.h"
+#include "timer.h"
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+
+/** Handed to every benchmark, which sets up its objects and then times its loop with
+ * while (state.keepRunning()) { ... } like Google Benchmark does. Only the loop is timed.
+ **/
+class State
+{
+	public:
+		State(size_t objects, size_t iterations) : objects(objects), iterations(iterations), done(0), seconds(0.0) { }
+
+		bool keepRunning()
+		{
+			if (done == 0)
+			{
+				timer.reset();
+				startAllocations = threadAllocations();
+			}
+			if (done++ < iterations)
+			{
+				return true;
+			}
+			seconds = timer.time();
+			allocations = threadAllocations() - startAllocations;
+			return false;
+		}
+
+		/** 1k, 10k or 100k, every iteration works on all of them **/
+		const size_t objects;
+		const size_t iterations;
+
+		double getSeconds() const { return seconds; }
+		const AllocationCounts& getAllocations() const { return allocations; }
+
+	private:
+		size_t done;
+		Timer timer;
+		double seconds;
+		AllocationCounts startAllocations, allocations;
+};
+
+/** keeps the compiler from optimising away a result nobody reads **/
+template<class T>
+inline void doNotOptimize(const T& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+typedef void (*BenchmarkFunction)(State&);
+
+struct Benchmark
+{
+	std::string name;
+	BenchmarkFunction function;
+};
+
+static std::vector<Benchmark>& benchmarks()
+{
+	static std::vector<Benchmark> registered;
+	return registered;
+}
+
+struct Registration
+{
+	Registration(const char* name, BenchmarkFunction function)
+	{
+		Benchmark benchmark = { name, function };
+		benchmarks().push_back(benchmark);
+	}
+};
+
+#define BENCHMARK(function) static Registration registration_##function(#function, function)
+
+/** a WorldGraph of count objects, as physics posts it **/
+static void makeWorldGraph(size_t count, WorldGraph& graph)
+{
+	graph.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		Transform transform;
+		transform.pos = Ogre::Vector3(Ogre::Math::RangeRandom(-1000, 1000), Ogre::Math::RangeRandom(0, 100), Ogre::Math::RangeRandom(-1000, 1000));
+		transform.orient.FromAngleAxis(Ogre::Radian(Ogre::Math::RangeRandom(0.0, Ogre::Math::TWO_PI)), Ogre::Vector3::UNIT_Y);
+		graph.ids.push_back(i + 1);
+		graph.transforms.push_back(transform);
+	}
+	graph.time = 1.0;
+}
+
+/** the graph a tick later, everything moved a bit **/
+static void advance(const WorldGraph& from, WorldGraph& to)
+{
+	to = from;
+	for (size_t i = 0; i < to.size(); i++)
+	{
+		to.transforms[i].pos += Ogre::Vector3(0.1, -0.2, 0.1);
+		to.transforms[i].orient = to.transforms[i].orient * Ogre::Quaternion(Ogre::Radian(0.01), Ogre::Vector3::UNIT_Y);
+	}
+	to.time = from.time + 1.0 / 150;
+}
+
+static void WorldGraphCopyConstruct(State& state)
+{
+	WorldGraph graph;
+	makeWorldGraph(state.objects, graph);
+	while (state.keepRunning())
+	{
+		WorldGraph copy(graph);
+		doNotOptimize(copy);
+	}
+}
+BENCHMARK(WorldGraphCopyConstruct);
+
+/** what GraphicsImpl::handleWorldEvents does with every snapshot, the target keeps its capacity **/
+static void WorldGraphAssign(State& state)
+{
+	WorldGraph graph, snapshot;
+	makeWorldGraph(state.objects, graph);
+	while (state.keepRunning())
+	{
+		snapshot = graph;
+		doNotOptimize(snapshot);
+	}
+}
+BENCHMARK(WorldGraphAssign);
+
+/** wrapping a payload into a DataContainer and getting it out again, objects times **/
+static void DataContainerRoundTrip(State& state)
+{
+	WorldGraph graph;
+	while (state.keepRunning())
+	{
+		for (size_t i = 0; i < state.objects; i++)
+		{
+			DataContainer data(&graph);
+			WorldGraph* received = boost::any_cast<WorldGraph*>(data.data);
+			doNotOptimize(received);
+		}
+	}
+}
+BENCHMARK(DataContainerRoundTrip);
+
+/** subscribes like GraphicsImpl, the Threadmanager never runs it; handlers are called by the poster **/
+class FeedReader : public Task
+{
+	public:
+		FeedReader()
+		{
+			subscribeToFeed("bench_world", boost::bind(&FeedReader::handleWorldEvents, this, _1));
+		}
+
+		WorldGraph snapshot;
+
+	protected:
+		bool doStep() { return false; }
+		void threadWillStart() { }
+		void threadWillStop() { }
+
+	private:
+		void handleWorldEvents(const DataContainer& data)
+		{
+			snapshot = *boost::any_cast<WorldGraph*>(data.data);
+		}
+};
+
+/** one world_dynamic post as physics sends it, including the copy on the receiving side **/
+static void PostWorldGraph(State& state)
+{
+	static FeedReader reader;
+	WorldGraph graph;
+	makeWorldGraph(state.objects, graph);
+	DataContainer data(&graph);
+	while (state.keepRunning())
+	{
+		InformationManager::Instance()->postDataToFeed("bench_world", data);
+	}
+	doNotOptimize(reader.snapshot);
+}
+BENCHMARK(PostWorldGraph);
+
+static const char* MESHES[] = { "cube.mesh", "barrel.mesh", "crate.mesh", "tudorhouse.mesh" };
+
+/** what loading a level of objects objects costs the registry; it keeps every object, so it grows with every iteration **/
+static void RegistryAddObject(State& state)
+{
+	ObjectRegistry& registry = ObjectRegistry::Instance();
+	std::vector<std::string> names;
+	for (size_t i = 0; i < sizeof(MESHES) / sizeof(MESHES[0]); i++)
+	{
+		names.push_back(MESHES[i]);
+	}
+	while (state.keepRunning())
+	{
+		for (size_t i = 0; i < state.objects; i++)
+		{
+			doNotOptimize(registry.addObject(names[i % names.size()]));
+		}
+	}
+}
+BENCHMARK(RegistryAddObject);
+
+static void RegistryGetNameForID(State& state)
+{
+	ObjectRegistry& registry = ObjectRegistry::Instance();
+	std::vector<int> ids;
+	for (size_t i = 0; i < state.objects; i++)
+	{
+		ids.push_back(registry.addObject(MESHES[i % (sizeof(MESHES) / sizeof(MESHES[0]))]));
+	}
+	while (state.keepRunning())
+	{
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			doNotOptimize(registry.getNameForID(ids[i]).size());
+		}
+	}
+}
+BENCHMARK(RegistryGetNameForID);
+
+static void QuatPosToMatrix(State& state)
+{
+	WorldGraph graph;
+	makeWorldGraph(state.objects, graph);
+	std::vector<float> matrices(state.objects * 16);
+	while (state.keepRunning())
+	{
+		for (size_t i = 0; i < state.objects; i++)
+		{
+			OgreNewt::Converters::QuatPosToMatrix(graph.transforms[i].orient, graph.transforms[i].pos, &matrices[i * 16]);
+		}
+		doNotOptimize(matrices[0]);
+	}
+}
+BENCHMARK(QuatPosToMatrix);
+
+/** Body::updateNode on bodies without a node, what is left is the interpolation itself **/
+static void BodyUpdateNode(State& state)
+{
+	OgreNewt::World world;
+	OgreNewt::CollisionPtr col(new OgreNewt::CollisionPrimitives::Box(&world, Ogre::Vector3(1.0, 1.0, 1.0), 0));
+	WorldGraph from, to;
+	makeWorldGraph(state.objects, from);
+	advance(from, to);
+	std::vector<OgreNewt::Body*> bodies;
+	for (size_t i = 0; i < state.objects; i++)
+	{
+		OgreNewt::Body* body = new OgreNewt::Body(&world, col);
+		// setPositionOrientation sets the previous and the current transform, and Slerp of two equal rotations takes a shortcut
+		body->setPositionOrientation(from.transforms[i].pos, from.transforms[i].orient);
+		// so move the body on like a step does, the transform callback keeps the old one as the previous
+		float matrix[16];
+		OgreNewt::Converters::QuatPosToMatrix(to.transforms[i].orient, to.transforms[i].pos, matrix);
+		NewtonBodySetMatrix(body->getNewtonBody(), matrix);
+		NewtonBodyGetTransformCallback(body->getNewtonBody())(body->getNewtonBody(), matrix, 0);
+		bodies.push_back(body);
+	}
+
+	while (state.keepRunning())
+	{
+		for (size_t i = 0; i < bodies.size(); i++)
+		{
+			bodies[i]->updateNode(0.5);
+		}
+	}
+
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		delete bodies[i];
+	}
+}
+BENCHMARK(BodyUpdateNode);
+
+/** how GraphicsImpl found the scene node of an ID before it kept an EntityStore **/
+static void MapFind(State& state)
+{
+	std::map<int, Transform> objects;
+	for (size_t i = 0; i < state.objects; i++)
+	{
+		objects[i + 1] = Transform();
+	}
+	while (state.keepRunning())
+	{
+		for (size_t i = 0; i < state.objects; i++)
+		{
+			doNotOptimize(objects.find(i + 1)->second);
+		}
+	}
+}
+BENCHMARK(MapFind);
+
+/** the lookup GraphicsImpl::interpolateRange does for every object of a snapshot **/
+static void EntityStoreFind(State& state)
+{
+	EntityStore entities;
+	for (size_t i = 0; i < state.objects; i++)
+	{
+		entities.add(i + 1, COMPONENT_TRANSFORM | COMPONENT_SPECIFICATION | COMPONENT_RENDER);
+	}
+	while (state.keepRunning())
+	{
+		for (size_t i = 0; i < state.objects; i++)
+		{
+			size_t row;
+			doNotOptimize(entities.find(i + 1, row));
+		}
+	}
+}
+BENCHMARK(EntityStoreFind);
+
+/** GraphicsImpl::interpolateRange over a whole snapshot, on one thread **/
+static void InterpolateSnapshot(State& state)
+{
+	WorldGraph from, to;
+	makeWorldGraph(state.objects, from);
+	advance(from, to);
+	EntityStore entities;
+	for (size_t i = 0; i < state.objects; i++)
+	{
+		entities.add(to.ids[i], COMPONENT_TRANSFORM | COMPONENT_SPECIFICATION | COMPONENT_RENDER);
+	}
+
+	Ogre::Real t = 0.5;
+	while (state.keepRunning())
+	{
+		for (size_t i = 0; i < to.size(); i++)
+		{
+			size_t row;
+			Archetype* entity = entities.find(to.ids[i], row);
+			Transform& transform = entity->transforms[row];
+			transform.pos = from.transforms[i].pos + (to.transforms[i].pos - from.transforms[i].pos) * t;
+			transform.orient = Ogre::Quaternion::Slerp(t, from.transforms[i].orient, to.transforms[i].orient, true);
+		}
+	}
+}
+BENCHMARK(InterpolateSnapshot);
+
+/** Runs benchmark with objects objects, with more iterations until the loop took long enough to
+ * be trusted, and prints the time per iteration and per object
+ **/
+static void run(const Benchmark& benchmark, size_t objects)
+{
+	const double MIN_SECONDS = 0.5;
+	size_t iterations = 1;
+	while (true)
+	{
+		State state(objects, iterations);
+		benchmark.function(state);
+
+		double seconds = state.getSeconds();
+		if (seconds >= MIN_SECONDS || iterations >= 1000000000)
+		{
+			double perIteration = seconds / iterations;
+			std::cout << std::setw(32) << std::left << benchmark.name + "/" + boost::lexical_cast<std::string>(objects)
+			          << std::setw(12) << std::right << iterations
+			          << std::setw(14) << std::fixed << std::setprecision(2) << perIteration * 1e6 << " us"
+			          << std::setw(11) << perIteration * 1e9 / objects << " ns"
+			          << std::setw(12) << std::setprecision(1) << double(state.getAllocations().allocations) / iterations << std::endl;
+			return;
+		}
+
+		// aim a bit above the minimum, but never more than ten times as many as last time
+		double factor = seconds > 0.0 ? MIN_SECONDS * 1.4 / seconds : 10.0;
+		iterations = std::max(iterations + 1, size_t(iterations * std::min(factor, 10.0)));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	// enginebench [filter] [objects]: only benchmarks whose name contains filter, only at objects objects
+	std::string filter = argc > 1 ? argv[1] : "";
+	std::vector<size_t> sizes;
+	if (argc > 2)
+	{
+		sizes.push_back(boost::lexical_cast<size_t>(argv[2]));
+	}
+	else
+	{
+		sizes.push_back(1000);
+		sizes.push_back(10000);
+		sizes.push_back(100000);
+	}
+
+	initDebug();
+	// Ogre's math and Newton need it, nothing is rendered
+	new Ogre::Root("", "", "enginebench.log");
+
+	std::cout << std::setw(32) << std::left << "benchmark/objects" << std::setw(12) << std::right << "iterations"
+	          << std::setw(17) << "per iteration" << std::setw(14) << "per object" << std::setw(12) << "allocs/it" << std::endl;
+
+	for (size_t i = 0; i < benchmarks().size(); i++)
+	{
+		if (benchmarks()[i].name.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+		for (size_t j = 0; j < sizes.size(); j++)
+		{
+			run(benchmarks()[i], sizes[j]);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,342 @@
+//
+// C++ Implementation: physicsbench
+//
+// Description: Steps generated scenes of the game's spawn bodies for a fixed number of
+// ticks, without graphics or input, and reports how fast physics is.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "Ogre.h"
+#include "OgreNewt.h"
+#include "FeedDataTypes.h"
+#include "entitystore.h"
+#include "levelfile.h"
+#include "timer.h"
+#include "worldshards.h"
+#include "ccdpolicy.h"
+#include "physicsstate.h"
+
+#include <boost/lexical_cast.hpp>
+#include <boost/random/linear_congruential.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <sys/resource.h>
+
+/** the collision PhysicsImpl::newObject gives spawned objects without a baked one **/
+static const Ogre::Real RADIUS = 4.9;
+static const Ogre::Real HEIGHT = 9.8;
+
+/** Creates the bodies the way PhysicsImpl::newObject does, so the numbers match the game **/
+class Scene
+{
+	public:
+		Scene(int shardCount, int rate) : shards(Ogre::AxisAlignedBox(Ogre::Vector3(-1000.0, -1000.0, -1000.0), Ogre::Vector3(1000.0, 1000.0, 1000.0)), shardCount, rate), timestep(1.0 / rate), nextID(0)
+		{
+		}
+
+		/** the static objects of a compiled level with their baked tree collisions, false if there are none **/
+		bool addTerrain(const std::string& path)
+		{
+			LevelFile level;
+			if (!level.open(path))
+			{
+				std::cerr << "Can't open " << path << ": " << level.getError() << std::endl;
+				return false;
+			}
+
+			int added = 0;
+			for (uint32_t i = 0; i < level.getPlacementCount(); i++)
+			{
+				Terrain terrain;
+				level.getTerrain(i, terrain);
+				const void* blob;
+				size_t blobSize;
+				if (!level.findCollision(terrain.specification, terrain.scale, LEVEL_COLLISION_TREE, blob, blobSize))
+				{
+					std::cerr << path << " has no collision for " << terrain.specification << ", run the serializer" << std::endl;
+					continue;
+				}
+
+				Ogre::MemoryDataStream stream(const_cast<void*>(blob), blobSize, false);
+				OgreNewt::CollisionSerializer serializer;
+				OgreNewt::CollisionPtr col = serializer.importCollision(stream, shards.getWorld(0));
+				addStatic(col, terrain.node.pos, terrain.node.orient);
+				added++;
+			}
+			return added > 0;
+		}
+
+		/** a large flat box at y = 0, when there is no level to load **/
+		void addFloor()
+		{
+			OgreNewt::CollisionPtr col(new OgreNewt::CollisionPrimitives::Box(shards.getWorld(0), Ogre::Vector3(2000.0, 1.0, 2000.0), nextID++));
+			addStatic(col, Ogre::Vector3(0.0, -0.5, 0.0), Ogre::Quaternion::IDENTITY);
+		}
+
+		/** height of the ground below x, z, 0 if there is none **/
+		Ogre::Real groundAt(Ogre::Real x, Ogre::Real z)
+		{
+			Ogre::Vector3 start(x, 900.0, z), end(x, -900.0, z);
+			OgreNewt::BasicRaycast ray(shards.getWorld(shards.getShardFor(start)), start, end, true);
+			if (ray.getHitCount() == 0)
+			{
+				return 0.0;
+			}
+			return start.y + (end.y - start.y) * ray.getFirstHit().mDistance;
+		}
+
+		void addBody(const Ogre::Vector3& pos, const Ogre::Quaternion& orient, const Ogre::Vector3& velocity)
+		{
+			int ID = nextID++;
+			OgreNewt::World* world = shards.getWorldFor(pos);
+			OgreNewt::CollisionPtr col(new OgreNewt::CollisionPrimitives::Cylinder(world, RADIUS, HEIGHT, ID));
+			OgreNewt::Body* body = new OgreNewt::Body(world, col);
+			Ogre::Vector3 inertia, offset;
+			NewtonConvexCollisionCalculateInertialMatrix(col->getNewtonCollision(), &inertia.x, &offset.x);
+			body->setMassMatrix(10.0, 10.0 * inertia);
+			body->setStandardForceCallback();
+			body->setVelocity(velocity);
+			body->setPositionOrientation(pos, orient);
+			ccdPolicy.evaluate(body, timestep);
+
+			size_t row = entities.add(ID, COMPONENT_TRANSFORM | COMPONENT_BODY | COMPONENT_SHARD);
+			Archetype* entity = entities.find(ID, row);
+			entity->transforms[row].pos = pos;
+			entity->transforms[row].orient = orient;
+			entity->bodies[row] = body;
+			entity->shards[row] = shards.getShardFor(pos);
+		}
+
+		/** one tick of PhysicsImpl::stepWorld **/
+		void step()
+		{
+			shards.update(timestep, entities);
+			for (int i = 0; i < shards.getShardCount(); i++)
+			{
+				ccdPolicy.update(shards.getWorld(i), timestep);
+			}
+		}
+
+		size_t getBodyCount() const { return entities.getEntityCount(); }
+		EntityStore& getEntities() { return entities; }
+
+		int getSleepingCount()
+		{
+			int asleep = 0;
+			std::vector<Archetype*> moving;
+			entities.query(COMPONENT_BODY, moving);
+			for (size_t i = 0; i < moving.size(); i++)
+			{
+				for (size_t j = 0; j < moving[i]->size(); j++)
+				{
+					asleep += NewtonBodyGetSleepState(moving[i]->bodies[j]->getNewtonBody()) ? 1 : 0;
+				}
+			}
+			return asleep;
+		}
+
+		int getMigrations() const { return shards.getMigrations(); }
+		int getCCDBodies() const { return ccdPolicy.getCCDBodies(); }
+
+	private:
+		/** static geometry lives in every shard, like in PhysicsImpl::newObject **/
+		void addStatic(const OgreNewt::CollisionPtr& col, const Ogre::Vector3& pos, const Ogre::Quaternion& orient)
+		{
+			for (int i = 0; i < shards.getShardCount(); i++)
+			{
+				OgreNewt::Body* body = new OgreNewt::Body(shards.getWorld(i), shards.getCollision(col, i));
+				body->setPositionOrientation(pos, orient);
+			}
+		}
+
+		WorldShards shards;
+		CCDPolicy ccdPolicy;
+		EntityStore entities;
+		Ogre::Real timestep;
+		int nextID;
+};
+
+/** the grid of GameImpl::handleGUIEvents (5 gives the game's 125 bodies), flying towards the origin **/
+static void buildGrid(Scene& scene, int size)
+{
+	boost::minstd_rand generator(42);
+	boost::uniform_real<> uni_dist(-2, 2);
+	boost::variate_generator<boost::minstd_rand&, boost::uniform_real<> > uni(generator, uni_dist);
+
+	int spaceInBetween = 20;
+	for (int i = 0; i < size; i++)
+	{
+		for (int j = 0; j < size; j++)
+		{
+			for (int k = 0; k < size; k++)
+			{
+				Ogre::Vector3 pos(spaceInBetween/2 * size - i * spaceInBetween + uni(), spaceInBetween/2 * size - k * spaceInBetween + uni(), spaceInBetween/2 * size - j * spaceInBetween + uni());
+				// newObject starts every body moving towards the origin
+				scene.addBody(pos, Ogre::Quaternion::IDENTITY, -pos);
+			}
+		}
+	}
+}
+
+/** size layers of lying cylinders, size x size at the bottom, resting on the ground at the origin **/
+static void buildPyramid(Scene& scene, int size)
+{
+	Ogre::Real ground = scene.groundAt(0.0, 0.0);
+	// Newton's cylinders lie along x, so this is their footprint
+	Ogre::Real width = HEIGHT + 0.1, depth = 2 * RADIUS + 0.1;
+
+	for (int layer = 0; layer < size; layer++)
+	{
+		int count = size - layer;
+		Ogre::Real y = ground + RADIUS + 0.1 + layer * (2 * RADIUS + 0.1);
+		for (int i = 0; i < count; i++)
+		{
+			for (int j = 0; j < count; j++)
+			{
+				Ogre::Vector3 pos((i - (count - 1) * 0.5) * width, y, (j - (count - 1) * 0.5) * depth);
+				scene.addBody(pos, Ogre::Quaternion::IDENTITY, Ogre::Vector3::ZERO);
+			}
+		}
+	}
+}
+
+/** size^3 bodies in a loose column above the origin, which collapses into a heap **/
+static void buildPile(Scene& scene, int size)
+{
+	boost::minstd_rand generator(42);
+	boost::uniform_real<> uni_dist(-1, 1);
+	boost::variate_generator<boost::minstd_rand&, boost::uniform_real<> > uni(generator, uni_dist);
+
+	Ogre::Real ground = scene.groundAt(0.0, 0.0);
+	// enough room for a cylinder turned any way around y
+	Ogre::Real spacing = 1.5 * HEIGHT;
+	for (int layer = 0; layer < size; layer++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			for (int j = 0; j < size; j++)
+			{
+				Ogre::Vector3 pos((i - (size - 1) * 0.5) * spacing + uni(), ground + 20.0 + layer * spacing, (j - (size - 1) * 0.5) * spacing + uni());
+				Ogre::Quaternion orient(Ogre::Radian(uni() * Ogre::Math::PI), Ogre::Vector3::UNIT_Y);
+				scene.addBody(pos, orient, Ogre::Vector3::ZERO);
+			}
+		}
+	}
+}
+
+/** value at quantile q (0..1) of sorted **/
+static double quantile(const std::vector<double>& sorted, double q)
+{
+	return sorted[std::min(sorted.size() - 1, (size_t)(q * sorted.size()))];
+}
+
+int main(int argc, char *argv[])
+{
+	// physicsbench [grid|pyramid|pile] [size] [ticks] [shards] [level]
+	std::string sceneName = argc > 1 ? argv[1] : "grid";
+	int size = argc > 2 ? boost::lexical_cast<int>(argv[2]) : 5;
+	int ticks = argc > 3 ? boost::lexical_cast<int>(argv[3]) : 1000;
+	int shardCount = argc > 4 ? boost::lexical_cast<int>(argv[4]) : 1;
+	std::string levelPath = argc > 5 ? argv[5] : "Media/custom/level";
+	// the game's default physics_rate
+	int rate = 150;
+
+	if (size < 1 || ticks < 1 || (sceneName != "grid" && sceneName != "pyramid" && sceneName != "pile"))
+	{
+		std::cerr << "usage: physicsbench [grid|pyramid|pile] [size] [ticks] [shards] [level]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// no render system, OgreNewt only needs the log
+	new Ogre::Root("", "", "physicsbench.log");
+
+	Scene scene(shardCount, rate);
+	std::string terrain = levelPath;
+	if (!scene.addTerrain(levelPath))
+	{
+		terrain = "floor";
+		scene.addFloor();
+	}
+
+	if (sceneName == "grid")
+	{
+		buildGrid(scene, size);
+	}
+	else if (sceneName == "pyramid")
+	{
+		buildPyramid(scene, size);
+	}
+	else
+	{
+		buildPile(scene, size);
+	}
+
+	std::vector<double> stepTimes;
+	stepTimes.reserve(ticks);
+	Timer total;
+	for (int i = 0; i < ticks; i++)
+	{
+		Timer timer;
+		scene.step();
+		stepTimes.push_back(timer.time());
+	}
+	double elapsed = total.time();
+	std::sort(stepTimes.begin(), stepTimes.end());
+
+	// rollback as reconciliation would do it: capture, simulate a few ticks, rewind to the capture
+	const int ROLLBACKS = 50;
+	const int ROLLBACK_TICKS = 4;
+	PhysicsState state, check;
+	state.capture(scene.getEntities());
+	double captureTime = 0.0, restoreTime = 0.0;
+	size_t mismatches = 0;
+	for (int i = 0; i < ROLLBACKS; i++)
+	{
+		Timer timer;
+		state.capture(scene.getEntities());
+		captureTime += timer.time();
+		for (int j = 0; j < ROLLBACK_TICKS; j++)
+		{
+			scene.step();
+		}
+		timer.reset();
+		state.restore(scene.getEntities());
+		restoreTime += timer.time();
+
+		check.capture(scene.getEntities());
+		mismatches += !check.equals(state);
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	std::cout << sceneName << " " << size << ": " << scene.getBodyCount() << " bodies on " << terrain << ", " << ticks << " ticks at " << rate
+		<< " Hz, " << shardCount << " shards, " << boost::thread::hardware_concurrency() << " cores" << std::endl;
+	std::cout << std::fixed << std::setprecision(3)
+		<< "steps/sec:        " << ticks / elapsed << std::endl
+		<< "step ms p50/p99:  " << quantile(stepTimes, 0.5) * 1000.0 << " / " << quantile(stepTimes, 0.99) * 1000.0 << " (max " << stepTimes.back() * 1000.0 << ")" << std::endl
+		<< "newton memory:    " << NewtonGetMemoryUsed() / 1024 << " KB" << std::endl
+		<< "peak RSS:         " << usage.ru_maxrss << " KB" << std::endl
+		<< "rollback us:      capture " << captureTime / ROLLBACKS * 1e6 << ", restore " << restoreTime / ROLLBACKS * 1e6 << " after " << ROLLBACK_TICKS
+		<< " ticks (" << state.getMemoryUsed() / 1024 << " KB, " << mismatches << " of " << ROLLBACKS << " not restored exactly)" << std::endl
+		<< "at the end:       " << scene.getSleepingCount() << " asleep, " << scene.getCCDBodies() << " in CCD, " << scene.getMigrations() << " migrations" << std::endl;
+
+	// one line per run, easy to collect from several commits or machines
+	std::cout << "RESULT scene=" << sceneName << " size=" << size << " bodies=" << scene.getBodyCount() << " ticks=" << ticks << " shards=" << shardCount
+		<< " steps_per_sec=" << ticks / elapsed << " p50_ms=" << quantile(stepTimes, 0.5) * 1000.0 << " p99_ms=" << quantile(stepTimes, 0.99) * 1000.0
+		<< " newton_kb=" << NewtonGetMemoryUsed() / 1024 << " rss_kb=" << usage.ru_maxrss
+		<< " capture_us=" << captureTime / ROLLBACKS * 1e6 << " restore_us=" << restoreTime / ROLLBACKS * 1e6 << std::endl;
+
+	return EXIT_SUCCESS;
+}
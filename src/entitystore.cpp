@@ -0,0 +1,157 @@
+//
+// C++ Implementation: entitystore
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "entitystore.h"
+
+/** value of a component which was just added: zero, null, or the identity for transforms and scales **/
+template<typename T> static T emptyValue() { return T(); }
+template<> Ogre::Vector3 emptyValue<Ogre::Vector3>() { return Ogre::Vector3::UNIT_SCALE; }
+
+/** appends row of from (or an empty value if from doesn't have the column) to to, if to has the column **/
+template<typename T> static void appendValue(std::vector<T>& to, bool toHas, const std::vector<T>* from, bool fromHas, size_t row)
+{
+	if(!toHas)
+	{
+		return;
+	}
+	to.push_back(from && fromHas ? (*from)[row] : emptyValue<T>());
+}
+
+template<typename T> static void swapPop(std::vector<T>& column, size_t row)
+{
+	if(column.empty())
+	{
+		return;
+	}
+	column[row] = column.back();
+	column.pop_back();
+}
+
+EntityStore::EntityStore() : entityCount(0)
+{
+}
+
+EntityStore::~EntityStore()
+{
+	for(size_t i = 0; i < archetypes.size(); i++)
+	{
+		delete archetypes[i];
+	}
+}
+
+Archetype* EntityStore::getArchetype(ComponentMask mask, int& index)
+{
+	std::map<ComponentMask, int>::iterator it = archetypeIndex.find(mask);
+	if(it != archetypeIndex.end())
+	{
+		index = it->second;
+		return archetypes[index];
+	}
+
+	Archetype* archetype = new Archetype;
+	archetype->mask = mask;
+	index = archetypes.size();
+	archetypes.push_back(archetype);
+	archetypeIndex[mask] = index;
+	return archetype;
+}
+
+size_t EntityStore::add(int ID, ComponentMask mask)
+{
+	if(ID >= (int)locations.size())
+	{
+		locations.resize(ID + 1);
+	}
+	Location& location = locations[ID];
+
+	Archetype* from = location.archetype >= 0 ? archetypes[location.archetype] : 0;
+	if(from && from->mask == mask)
+	{
+		return location.row;
+	}
+
+	int index;
+	Archetype* to = getArchetype(mask, index);
+	ComponentMask had = from ? from->mask : 0;
+
+	to->ids.push_back(ID);
+	appendValue(to->transforms, to->has(COMPONENT_TRANSFORM), from ? &from->transforms : 0, had & COMPONENT_TRANSFORM, location.row);
+	appendValue(to->scales, to->has(COMPONENT_SCALE), from ? &from->scales : 0, had & COMPONENT_SCALE, location.row);
+	appendValue(to->specifications, to->has(COMPONENT_SPECIFICATION), from ? &from->specifications : 0, had & COMPONENT_SPECIFICATION, location.row);
+	appendValue(to->bodies, to->has(COMPONENT_BODY), from ? &from->bodies : 0, had & COMPONENT_BODY, location.row);
+	appendValue(to->shards, to->has(COMPONENT_SHARD), from ? &from->shards : 0, had & COMPONENT_SHARD, location.row);
+	appendValue(to->renderHandles, to->has(COMPONENT_RENDER), from ? &from->renderHandles : 0, had & COMPONENT_RENDER, location.row);
+
+	if(from)
+	{
+		eraseRow(location.archetype, location.row);
+	}
+	else
+	{
+		entityCount++;
+	}
+
+	location.archetype = index;
+	location.row = to->size() - 1;
+	return location.row;
+}
+
+void EntityStore::remove(int ID)
+{
+	if(!contains(ID))
+	{
+		return;
+	}
+
+	eraseRow(locations[ID].archetype, locations[ID].row);
+	locations[ID] = Location();
+	entityCount--;
+}
+
+void EntityStore::eraseRow(int index, size_t row)
+{
+	Archetype* archetype = archetypes[index];
+
+	// the last entity fills the hole
+	int moved = archetype->ids.back();
+	locations[moved].row = row;
+
+	swapPop(archetype->ids, row);
+	swapPop(archetype->transforms, row);
+	swapPop(archetype->scales, row);
+	swapPop(archetype->specifications, row);
+	swapPop(archetype->bodies, row);
+	swapPop(archetype->shards, row);
+	swapPop(archetype->renderHandles, row);
+}
+
+Archetype* EntityStore::find(int ID, size_t& row) const
+{
+	if(!contains(ID))
+	{
+		return 0;
+	}
+
+	row = locations[ID].row;
+	return archetypes[locations[ID].archetype];
+}
+
+void EntityStore::query(ComponentMask mask, std::vector<Archetype*>& result) const
+{
+	result.clear();
+	for(size_t i = 0; i < archetypes.size(); i++)
+	{
+		if(archetypes[i]->has(mask))
+		{
+			result.push_back(archetypes[i]);
+		}
+	}
+}
@@ -13,7 +13,19 @@
 #include "game.h"
 #include "objectregistry.h"
 #include "settingsmanager.h"
+#include "startupprofiler.h"
+#include "mpscqueue.h"
+#include "wakeupsignal.h"
+#include "latencytracker.h"
+#include "levelfile.h"
+#include "resourcemanager.h"
+#include "timer.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "jobsystem.h"
+#include "physicsstate.h"
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
 #include "boost/filesystem.hpp"
 #include <boost/filesystem/fstream.hpp>
 #include <boost/archive/text_oarchive.hpp>
@@ -70,6 +82,7 @@ struct EvMainGameStarted : sc::event< EvMainGameStarted > {};
 struct EvSettingsDialogLaunched : sc::event< EvSettingsDialogLaunched > {};
 struct MainMenu : sc::simple_state< MainMenu, Active >
 {
+	MainMenu();
 	typedef mpl::list<
 	sc::transition< EvMainGameStarted, MainGame >,
 	sc::transition< EvSettingsDialogLaunched, Settings >
@@ -80,8 +93,12 @@ struct MainMenu : sc::simple_state< MainMenu, Active >
 class GameImpl : public Task
 {
 	public:
+		typedef void ( GameImpl::*EventHandler ) ( const DataContainer& data );
+
 		GameImpl();
 		~GameImpl();
+		/** called on the thread posting to the feed, hands data to handler on the game thread **/
+		void queueEvent ( EventHandler handler, const DataContainer& data );
 		void handleKeyEvents ( const DataContainer& data );
 		void handleGUIEvents ( const DataContainer& data );
 		void handleThreadEvents ( const DataContainer& data );
@@ -89,11 +106,31 @@ class GameImpl : public Task
 		void threadWillStart();
 		void threadWillStop();
 	private:
+		struct QueuedEvent
+		{
+			EventHandler handler;
+			DataContainer data;
+		};
+
+		/** longest the game thread sleeps without events, so it still notices when it should stop **/
+		static const double IDLE_TIMEOUT;
+
 		int loadingThreads;
 		GameState myState;
 		CameraPosition camPos;
+		MPSCQueue<QueuedEvent> events;
+		WakeupSignal eventsQueued;
+
+		/** metrics.txt is rewritten every metricsInterval seconds, 0 never **/
+		double metricsInterval, nextMetricsWrite;
+		Gauge* eventBacklog;
+		Gauge* jobBacklog;
+		/** F5 captures the physics into it, F9 rewinds to it **/
+		PhysicsStatePtr quicksave;
 };
 
+const double GameImpl::IDLE_TIMEOUT = 0.1;
+
 Game::Game() : impl(new GameImpl) { }
 Game::~Game() { }
 bool Game::doStep() { return impl->step(); }
@@ -115,27 +152,83 @@ Loading::~Loading()
 	InformationManager::Instance()->postDataToFeed ( "app_event", DataContainer ( APP_STARTED ) );
 }
 
+MainMenu::MainMenu()
+{
+	StartupProfiler::Instance().report();
+}
+
 MainGame::MainGame()
 {
-	Terrain terrain;
+	boost::shared_ptr<LevelFile> level ( new LevelFile );
 	{
-		boost::filesystem::ifstream file ( "Media/custom/terrain" );
-		ar::text_iarchive ia ( file );
-		ia >> terrain;
+		StartupPhase phase ( "game: map level" );
+		if ( !level->open ( "Media/custom/level" ) )
+		{
+			Derr << "Can't load level: " << level->getError();
+			return;
+		}
 	}
-	Dout << "My terrain: " << terrain.specification;
-	terrain.node.ID = ObjectRegistry::Instance().addObject ( terrain.specification );
+
+	// every mesh the level needs starts loading now, not once the first object asks for it
+	for ( uint32_t i = 0; i < level->getResourceCount(); i++ )
+	{
+		ResourceManager::Instance().requestResource ( level->getResource ( i ) );
+	}
+	// physics takes the prebuilt collisions from the level, so it has to know it before any object
+	InformationManager::Instance()->postDataToFeed ( "level_loaded", DataContainer ( level ) );
+
+	// graphics and physics get the whole level in one message instead of one per object
+	TerrainList terrain ( new std::vector<Terrain> ( level->getPlacementCount() ) );
+	for ( uint32_t i = 0; i < level->getPlacementCount(); i++ )
+	{
+		Terrain& placed = ( *terrain ) [i];
+		level->getTerrain ( i, placed );
+		placed.node.ID = ObjectRegistry::Instance().addObject ( placed.specification );
+	}
+	Dout << "Level with " << terrain->size() << " static objects and " << level->getSpawnCount() << " spawns";
 	InformationManager::Instance()->postDataToFeed ( "create_terrain", DataContainer ( terrain ) );
+
+	for ( uint32_t i = 0; i < level->getSpawnCount(); i++ )
+	{
+		// one allocation for the object and its reference count
+		boost::shared_ptr<ObjectToCreate> obj = boost::make_shared<ObjectToCreate>();
+		level->getObject ( i, *obj );
+		obj->node.ID = ObjectRegistry::Instance().addObject ( obj->specification );
+		InformationManager::Instance()->postDataToFeed ( "create_object", DataContainer ( obj ) );
+	}
 }
 
 void GameImpl::handleKeyEvents ( const DataContainer& data )
 {
 	InputKeyboardEvent ev = boost::any_cast<InputKeyboardEvent> ( data.data );
+	LatencyTracker::Instance().addSample ( "input to game", monotonicTime() - ev.captured );
 	if ( ev.type == KEY_UP && ev.action == BUTTON_PRESSED )
 	{
 		camPos.position += Ogre::Vector3 ( 0.0, 0.0, 1.0 );
 		InformationManager::Instance()->postDataToFeed ( "camera_position", DataContainer ( APP_SHUTDOWN ) );
 	}
+	else if ( ev.type == KEY_F12 && ev.action == BUTTON_PRESSED )
+	{
+		// the last zones of every thread, open in chrome://tracing
+		if ( Profiler::Instance().writeChromeTrace ( "trace.json" ) )
+		{
+			Dout << "Wrote profile to trace.json";
+		}
+	}
+	else if ( ev.type == KEY_F5 && ev.action == BUTTON_PRESSED )
+	{
+		if ( !quicksave )
+		{
+			quicksave.reset ( new PhysicsState );
+		}
+		InformationManager::Instance()->postDataToFeed ( "physics_capture", DataContainer ( quicksave ) );
+		Dout << "Captured " << quicksave->size() << " bodies at " << quicksave->getTime() << "s";
+	}
+	else if ( ev.type == KEY_F9 && ev.action == BUTTON_PRESSED && quicksave && !quicksave->empty() )
+	{
+		InformationManager::Instance()->postDataToFeed ( "physics_restore", DataContainer ( quicksave ) );
+		Dout << "Restored " << quicksave->size() << " bodies as they were at " << quicksave->getTime() << "s";
+	}
 	else if ( ( ev.type == KEY_Q || ev.type == KEY_ESCAPE ) && ev.action == BUTTON_PRESSED )
 	{
 		myState.process_event ( EvAppQuit() );
@@ -160,7 +253,7 @@ void GameImpl::handleGUIEvents ( const DataContainer& data )
 			{
 				for ( int k = 0; k < numOfObjects; k++ )
 				{
-					boost::shared_ptr<ObjectToCreate> obj(new ObjectToCreate);
+					boost::shared_ptr<ObjectToCreate> obj = boost::make_shared<ObjectToCreate>();
 					obj->node.pos = Ogre::Vector3 ( spaceInBetween/2 * numOfObjects - i * spaceInBetween + uni(), spaceInBetween/2 * numOfObjects - k * spaceInBetween + uni(), spaceInBetween/2 * numOfObjects - j * spaceInBetween + uni() );
 					obj->scale = Ogre::Vector3 ( 0.2,0.2,0.2 );
 					obj->node.orient = Ogre::Quaternion();
@@ -193,11 +286,17 @@ void GameImpl::handleThreadEvents ( const DataContainer& data )
 		if ( loadingThreads < 1 )
 		{
 			myState.process_event ( EvFinishedLoading() );
+
+			// nobody can press the button in headless mode, spawn the usual scene right away
+			if ( boost::any_cast<int> ( SettingsManager::Instance().getSetting ( "headless" ).data ) )
+			{
+				handleGUIEvents ( DataContainer ( DO_BUTTON ) );
+			}
 		}
 	}
 }
 
-GameImpl::GameImpl() : loadingThreads ( 0 )
+GameImpl::GameImpl() : loadingThreads ( 0 ), metricsInterval ( 0.0 ), nextMetricsWrite ( 0.0 ), eventBacklog ( NULL ), jobBacklog ( NULL )
 {
 	myState.initiate();
 }
@@ -207,21 +306,68 @@ GameImpl::~GameImpl()
 
 }
 
+void GameImpl::queueEvent ( EventHandler handler, const DataContainer& data )
+{
+	QueuedEvent ev;
+	ev.handler = handler;
+	ev.data = data;
+	events.push ( ev );
+	eventsQueued.notify();
+}
+
 bool GameImpl::doStep()
 {
-#ifndef DEBUG_BUILD
-	boost::this_thread::sleep ( boost::posix_time::milliseconds ( 10 ) );		// Wait 1/100 s
+#ifndef JOB_SYSTEM
+	// sleeps until an event arrives instead of polling, there is nothing else to do here
+	eventsQueued.waitFor ( IDLE_TIMEOUT );
 #endif
+	PROFILE_ZONE ( "game events" );
+	eventBacklog->set ( events.size() );
+	jobBacklog->set ( JobSystem::Instance().getQueuedCount() );
+
+	// the game thread wakes up at least every IDLE_TIMEOUT, often enough for the file
+	if ( metricsInterval > 0.0 && monotonicTime() >= nextMetricsWrite )
+	{
+		Metrics::Instance().writeFile ( "metrics.txt" );
+		nextMetricsWrite = monotonicTime() + metricsInterval;
+	}
+
+	QueuedEvent ev;
+	while ( events.pop ( ev ) )
+	{
+		( this->*ev.handler ) ( ev.data );
+	}
 	return true;
 }
 
 void GameImpl::threadWillStart()
 {
+	Profiler::Instance().nameThread ( "game" );
 	SettingsManager::Instance().addSetting("x_res", DataContainer(1024));
 	SettingsManager::Instance().addSetting("y_res", DataContainer(768));
-	subscribeToFeed ( "thread_event", boost::bind ( &GameImpl::handleThreadEvents, this, _1 ) );
-	subscribeToFeed ( "input_keyboard", boost::bind ( &GameImpl::handleKeyEvents, this, _1 ) );
-	subscribeToFeed ( "gui_event", boost::bind ( &GameImpl::handleGUIEvents, this, _1 ) );
+	SettingsManager::Instance().addSetting("physics_shards", DataContainer(1));
+	SettingsManager::Instance().addSetting("physics_rate", DataContainer(150));
+	// objects of one mesh arriving together are instanced once there are this many, 0 disables instancing
+	SettingsManager::Instance().addSetting("instancing_threshold", DataContainer(16));
+	// time per frame graphics may spend creating and removing scene nodes
+	SettingsManager::Instance().addSetting("scene_budget_ms", DataContainer(2));
+	// full Caelum updates per second, 0 updates the sky every frame
+	SettingsManager::Instance().addSetting("sky_update_rate", DataContainer(20));
+	// spawned meshes get reduced LOD levels at multiples of lod_distance, beyond impostor_distance they are billboards; 0 disables either
+	SettingsManager::Instance().addSetting("lod_distance", DataContainer(150));
+	SettingsManager::Instance().addSetting("impostor_distance", DataContainer(800));
+	// how often input devices are polled, OIS offers no way to wait for events; a key press waits up to
+	// this long to be captured, lower values cut input latency but wake the idle input thread more often
+	SettingsManager::Instance().addSetting("input_poll_ms", DataContainer(10));
+	// how often all metrics are written to metrics.txt in the Prometheus text format, 0 disables the file
+	SettingsManager::Instance().addSetting("metrics_interval_ms", DataContainer(1000));
+	metricsInterval = boost::any_cast<int> ( SettingsManager::Instance().getSetting ( "metrics_interval_ms" ).data ) / 1000.0;
+	eventBacklog = &Metrics::Instance().gauge ( "game_events_queued", "Events waiting for the game thread" );
+	jobBacklog = &Metrics::Instance().gauge ( "jobs_queued", "Jobs waiting for a worker of the job system" );
+	// the game logic runs on its own thread, so posting an event never blocks input or the GUI
+	subscribeToFeed ( "thread_event", boost::bind ( &GameImpl::queueEvent, this, &GameImpl::handleThreadEvents, _1 ) );
+	subscribeToFeed ( "input_keyboard", boost::bind ( &GameImpl::queueEvent, this, &GameImpl::handleKeyEvents, _1 ) );
+	subscribeToFeed ( "gui_event", boost::bind ( &GameImpl::queueEvent, this, &GameImpl::handleGUIEvents, _1 ) );
 }
 
 void GameImpl::threadWillStop()
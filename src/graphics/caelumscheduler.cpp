@@ -0,0 +1,81 @@
+//
+// C++ Implementation: caelumscheduler
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "caelumscheduler.h"
+
+CaelumScheduler::CaelumScheduler(Caelum::CaelumSystem* caelum, Ogre::Real rate) : caelum(caelum), interval(rate > 0 ? 1.0 / rate : 0.0), accumulated(0.0), updates(0)
+{
+	if (caelum->getSun()) {
+		addLight(caelum->getSun()->getMainLight());
+	}
+
+	if (caelum->getMoon()) {
+		addLight(caelum->getMoon()->getMainLight());
+	}
+
+	// start with a valid sky instead of waiting for the first interval
+	caelum->updateSubcomponents(0);
+	captureLights();
+	interpolateLights(1.0);
+}
+
+void CaelumScheduler::update(Ogre::Real timeSinceLastFrame)
+{
+	accumulated += timeSinceLastFrame;
+
+	if (accumulated >= interval) {
+		caelum->updateSubcomponents(accumulated);
+		accumulated = 0;
+		updates++;
+		captureLights();
+	}
+
+	interpolateLights(interval > 0 ? accumulated / interval : 1.0);
+}
+
+void CaelumScheduler::addLight(Ogre::Light* light)
+{
+	if (!light) {
+		return;
+	}
+
+	LightState state;
+	state.light = light;
+	state.direction = state.fromDirection = state.toDirection = light->getDirection();
+	state.colour = state.fromColour = state.toColour = light->getDiffuseColour();
+	lights.push_back(state);
+}
+
+void CaelumScheduler::captureLights()
+{
+	// Caelum has just written the new values into the lights, continue from what was shown last
+	for (std::vector<LightState>::iterator it = lights.begin(); it != lights.end(); ++it) {
+		it->fromDirection = it->direction;
+		it->fromColour = it->colour;
+		it->toDirection = it->light->getDirection();
+		it->toColour = it->light->getDiffuseColour();
+	}
+}
+
+void CaelumScheduler::interpolateLights(Ogre::Real t)
+{
+	t = std::min(t, Ogre::Real(1.0));
+
+	for (std::vector<LightState>::iterator it = lights.begin(); it != lights.end(); ++it) {
+		it->direction = it->fromDirection + (it->toDirection - it->fromDirection) * t;
+		it->direction.normalise();
+		it->colour = it->fromColour + (it->toColour - it->fromColour) * t;
+
+		it->light->setDirection(it->direction);
+		it->light->setDiffuseColour(it->colour);
+	}
+}
@@ -0,0 +1,56 @@
+//
+// C++ Interface: caelumscheduler
+//
+// Description: Advances the Caelum sky at a lower rate than the display.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#ifndef CAELUMSCHEDULER_H
+#define CAELUMSCHEDULER_H
+
+#include "Ogre.h"
+#include "Caelum.h"
+#include <vector>
+
+/** Caelum recalculates sky dome, sun, moon, clouds, stars and precipitation in every
+ * updateSubcomponents call. Instead of once per frame, the scheduler calls it rate times a second
+ * with the accumulated time, so the sky clock stays exact. The sun and moon lights would then
+ * visibly jump between updates, so they are interpolated from the previous to the latest update,
+ * which makes them lag one update interval behind.
+ **/
+class CaelumScheduler
+{
+	public:
+		/** a rate of 0 updates every frame **/
+		CaelumScheduler(Caelum::CaelumSystem* caelum, Ogre::Real rate);
+
+		/** call once per frame **/
+		void update(Ogre::Real timeSinceLastFrame);
+
+		/** number of full Caelum updates so far **/
+		unsigned int getUpdateCount() const { return updates; }
+
+	private:
+		struct LightState
+		{
+			Ogre::Light* light;
+			Ogre::Vector3 fromDirection, toDirection, direction;
+			Ogre::ColourValue fromColour, toColour, colour;
+		};
+
+		void addLight(Ogre::Light* light);
+		void captureLights();
+		void interpolateLights(Ogre::Real t);
+
+		Caelum::CaelumSystem* caelum;
+		Ogre::Real interval, accumulated;
+		std::vector<LightState> lights;
+		unsigned int updates;
+};
+
+#endif
@@ -0,0 +1,87 @@
+//
+// C++ Implementation: frametimings
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "frametimings.h"
+#include "timer.h"
+#include <taskengine/taskengine.h>
+#include <algorithm>
+
+FrameTimings::FrameTimings(double reportInterval) : reportInterval(reportInterval), lastReport(monotonicTime()), updateStart(0.0), frameStart(0.0), updateTime(0.0), renderTime(0.0)
+{
+}
+
+double FrameTimings::elapsed(double since) const
+{
+	return (monotonicTime() - since) * 1000.0;
+}
+
+void FrameTimings::beginUpdate()
+{
+	updateStart = monotonicTime();
+}
+
+void FrameTimings::endUpdate()
+{
+	updateTime = elapsed(updateStart);
+}
+
+bool FrameTimings::frameStarted(const Ogre::FrameEvent& evt)
+{
+	frameStart = monotonicTime();
+	return true;
+}
+
+bool FrameTimings::frameRenderingQueued(const Ogre::FrameEvent& evt)
+{
+	renderTime = elapsed(frameStart);
+	return true;
+}
+
+bool FrameTimings::frameEnded(const Ogre::FrameEvent& evt)
+{
+	updates.push_back(updateTime);
+	renders.push_back(renderTime);
+	frames.push_back(elapsed(frameStart));
+
+	if (elapsed(lastReport) > reportInterval * 1000.0) {
+		report();
+	}
+
+	return true;
+}
+
+void FrameTimings::report()
+{
+	if (frames.empty()) {
+		return;
+	}
+
+	Dout << frames.size() << " frames in " << elapsed(lastReport) / 1000.0 << "s, timings in ms (min / avg / p95 / max):";
+	reportSamples("update", updates);
+	reportSamples("render", renders);
+	reportSamples("frame", frames);
+
+	lastReport = monotonicTime();
+}
+
+void FrameTimings::reportSamples(const std::string& name, std::vector<double>& samples)
+{
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (std::vector<double>::const_iterator it = samples.begin(); it != samples.end(); ++it) {
+		sum += *it;
+	}
+
+	Dout << "  " << name << ": " << samples.front() << " / " << sum / samples.size() << " / " << samples[samples.size() * 95 / 100] << " / " << samples.back();
+	samples.clear();
+}
@@ -0,0 +1,51 @@
+//
+// C++ Interface: frametimings
+//
+// Description: Measures the CPU side cost of every rendered frame.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#ifndef FRAMETIMINGS_H
+#define FRAMETIMINGS_H
+
+#include "Ogre.h"
+#include <vector>
+
+/** Splits every frame into
+ * - update: our own work before rendering (scene commands, interpolation, LOD), see beginUpdate / endUpdate
+ * - render: Ogre from frameStarted to frameRenderingQueued, i.e. scene graph update, culling, render queue and draw calls
+ * - frame: frameStarted to frameEnded, which includes waiting for the GPU
+ * and logs min / average / 95th percentile / max of each every reportInterval seconds.
+ **/
+class FrameTimings : public Ogre::FrameListener
+{
+	public:
+		FrameTimings(double reportInterval);
+
+		void beginUpdate();
+		void endUpdate();
+
+		bool frameStarted(const Ogre::FrameEvent& evt);
+		bool frameRenderingQueued(const Ogre::FrameEvent& evt);
+		bool frameEnded(const Ogre::FrameEvent& evt);
+
+		/** logs the frames collected since the last report **/
+		void report();
+
+	private:
+		/** milliseconds passed since the monotonicTime() value since **/
+		double elapsed(double since) const;
+		void reportSamples(const std::string& name, std::vector<double>& samples);
+
+		double reportInterval;
+		double lastReport, updateStart, frameStart;
+		double updateTime, renderTime;
+		std::vector<double> updates, renders, frames;
+};
+
+#endif
@@ -20,12 +20,30 @@
 
 #include "graphics.h"
 #include "objectregistry.h"
+#include "resourcemanager.h"
+#include "startupprofiler.h"
+#include "jobsystem.h"
+#include "latencytracker.h"
 #include "settingsmanager.h"
 #include "FeedDataTypes.h"
 #include "boost/lexical_cast.hpp"
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <map>
 
 #include "listener.h"
+#include "instancebatcher.h"
+#include "caelumscheduler.h"
+#include "lodmanager.h"
+#include "frametimings.h"
+#include "mpscqueue.h"
+#include "entitystore.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "allocationtracker.h"
+#include "timer.h"
 #include "Ogre.h"
 #include "OgreConfigFile.h"
 #include "MyGUI.h"
@@ -35,13 +53,30 @@
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/filesystem.hpp>
+
+/** a change to the scene, queued by the feed handlers and applied by the render thread **/
+struct SceneCommand
+{
+	enum Type
+	{
+		ADD_OBJECT,
+		REMOVE_OBJECT,
+		CREATE_TERRAIN
+	};
+
+	Type type;
+	boost::shared_ptr<ObjectToCreate> object;
+	boost::shared_ptr<Terrain> terrain;
+	int ID;
+};
 
 class GraphicsImpl : public Task, public Ogre::WindowEventListener, public DataProvider
 {
 
 	public:
 		GraphicsImpl();
-		~GraphicsImpl() { }
+		~GraphicsImpl();
 
 		bool doStep();
 		void threadWillStart();
@@ -53,6 +88,9 @@ class GraphicsImpl : public Task, public Ogre::WindowEventListener, public DataP
 		void handleTerrainEvents(const DataContainer& data);
 		void handleWorldEvents(const DataContainer& data);
 		void handleRemovedObjects(const DataContainer& data);
+		void handleResourceLoaded(const DataContainer& data);
+		/** pushes command now if resource is loaded, else parks it in waitingForResource; resourceMutex must be held **/
+		void queueWhenLoaded(const std::string& specification, const ResourceHandle& resource, const SceneCommand& command);
 
 		DataContainer getData(const DataIdentifier& id);
 
@@ -61,16 +99,36 @@ class GraphicsImpl : public Task, public Ogre::WindowEventListener, public DataP
 		MyGUI::Gui* gui;
 		MyGUI::WidgetPtr mainGuiWidget;
 		Caelum::CaelumSystem* caelumSystem;
+		CaelumScheduler* skyScheduler;
 		Ogre::RenderSystem* rSys;
 		Ogre::RenderWindow* window;
+		/** what the camera renders to, the window or in headless mode an offscreen texture **/
+		Ogre::RenderTarget* renderTarget;
 		Ogre::SceneManager* sceneMgr;
 		Ogre::Camera* camera;
 		Ogre::Viewport* viewPort;
 		std::string resourcePath;
 		MyFrameListener* listener;
 
+		/** no GUI, sky or input, rendering goes to a texture and frame timings are logged **/
+		bool headless;
+		/** stop after this many seconds when headless **/
+		double headlessDuration;
+		FrameTimings* frameTimings;
+
+		/** a line of resources.cfg **/
+		struct ResourceLocation
+		{
+			Ogre::String name, type, group;
+		};
+		/** written by scanResources, read by setupResources once the scan was joined **/
+		std::vector<ResourceLocation> resourceLocations;
+
 		void loadPlugins();
+		/** registers the locations scanResources found with Ogre, on the graphics thread **/
 		void setupResources();
+		/** reads resources.cfg and lists the directories in it, touches nothing of Ogre's **/
+		void scanResources();
 		bool configure();
 		void chooseSceneManager();
 		void createCamera();
@@ -78,10 +136,22 @@ class GraphicsImpl : public Task, public Ogre::WindowEventListener, public DataP
 		void createResourceListener();
 		void loadResources();
 		void createScene();
+		void createSky();
 		void createFrameListener();
+		void addNodes(const std::vector< boost::shared_ptr<ObjectToCreate> >& objects);
 		void addNode(const boost::shared_ptr<ObjectToCreate>& object);
 		void removeNode(int ID);
 		void updatePositions();
+		/** returns false if there was nothing to apply **/
+		bool applySceneCommands();
+		void createTerrain(const Terrain& terrain);
+		/** called by the input handlers once the event changed what the next frame shows **/
+		void noteInput(double captured);
+		void updateDebugText();
+		void interpolateSnapshots();
+		void applySnapshot(const WorldGraph& from, const WorldGraph& to, Ogre::Real t);
+		/** writes the transforms of interpolateTo[first, last) into their entities, runs as a job **/
+		void interpolateRange(size_t first, size_t last);
 		void setupGUI();
 		void guiCallback(MyGUI::WidgetPtr sender);
 
@@ -93,23 +163,62 @@ class GraphicsImpl : public Task, public Ogre::WindowEventListener, public DataP
 		float moveScale;
 		Ogre::Vector3 movementVector;
 
-		/** WorldGraph currently used for rendering **/
-		WorldGraph* frontWorld;
-		/** WorldGraph which is updated in the background **/
-		WorldGraph* backWorld;
-		/** used to synch exchange of frontWorld and backWorld **/
+		/** number of physics snapshots kept for interpolation **/
+		static const int SNAPSHOT_COUNT = 4;
+		/** ring of the latest WorldGraphs received from physics, ordered by simulation time **/
+		WorldGraph* snapshots[SNAPSHOT_COUNT];
+		int newestSnapshot, snapshotCount;
+		/** simulation time which is currently rendered, trails the newest snapshot by about one tick **/
+		double renderTime;
+		/** guards the snapshot ring **/
 		boost::mutex worldMutex;
-		boost::mutex modifyNodesMutex;
-
-
-
-		std::map<int, Ogre::SceneNode*> nodes;
-		std::vector< boost::shared_ptr<ObjectToCreate> > nodesToAdd;
-		std::vector<int> nodesToRemove;
-		std::vector<Terrain> terrainToCreate;
-		bool newWorld;
+		/** capture times of input handled since the last frame started, guarded by inputMutex **/
+		std::vector<double> pendingInput;
+		/** capture times of the input the frame being rendered reflects **/
+		std::vector<double> frameInput;
+		boost::mutex inputMutex;
+		/** everything in the scene; moving objects have a COMPONENT_TRANSFORM, which applySnapshot fills **/
+		EntityStore entities;
+		/** reused by applySnapshot **/
+		std::vector<Archetype*> moving;
+		/** what interpolateRange blends, set by applySnapshot; members, so the job is small enough
+		 * for boost::function to keep it without allocating
+		 **/
+		const WorldGraph* interpolateFrom;
+		const WorldGraph* interpolateTo;
+		Ogre::Real interpolateT;
+		/** the debug text is only rebuilt when one of these changed **/
+		unsigned long debugSamples;
+		size_t debugBacklog;
+		/** reused, so rebuilding the text doesn't allocate once it has grown **/
+		std::string debugText;
+
+		/** draws objects sharing a mesh in batches, everything it refuses gets its own scene node **/
+		InstanceBatcher* instances;
+		/** LOD levels and impostors of the objects with their own scene node **/
+		LodManager* lod;
+		/** filled from any thread, applied in applySceneCommands within sceneBudget seconds per frame **/
+		MPSCQueue<SceneCommand> sceneCommands;
+		double sceneBudget;
+		/** objects and terrain whose mesh is still loading, by specification; handleResourceLoaded
+		 * moves them into sceneCommands, so a large level shows up piece by piece instead of stalling
+		 * a frame, and Ogre never touches a mesh a ResourceManager worker is still preparing
+		 **/
+		std::map< std::string, std::vector<SceneCommand> > waitingForResource;
+		boost::mutex resourceMutex;
+
+		/** live metrics, registered in threadWillStart **/
+		Histogram* frameTime;
+		Gauge* nodesUpdated;
+		Gauge* sceneBacklog;
+		/** allocations of updatePositions, rendering itself is up to Ogre **/
+		FrameAllocations* allocations;
+		/** transient data of updatePositions, reset at its end **/
+		FrameArena frameArena;
 };
 
+const int GraphicsImpl::SNAPSHOT_COUNT;
+
 Graphics::Graphics() : impl(new GraphicsImpl()) { }
 
 bool Graphics::doStep()
@@ -132,62 +241,145 @@ DataContainer Graphics::getData(const DataIdentifier& id)
 	return impl->getData(id);
 }
 
-GraphicsImpl::GraphicsImpl() : movementVector(0, 0, 0), frontWorld(new WorldGraph), backWorld(new WorldGraph), newWorld(false)
+GraphicsImpl::GraphicsImpl() : gui(NULL), caelumSystem(NULL), skyScheduler(NULL), listener(NULL), headless(false), headlessDuration(0.0), frameTimings(NULL), movementVector(0, 0, 0), newestSnapshot(SNAPSHOT_COUNT - 1), snapshotCount(0), renderTime(0.0), interpolateFrom(NULL), interpolateTo(NULL), interpolateT(0), debugSamples(0), debugBacklog(0), instances(NULL), lod(NULL), sceneBudget(0.002), frameTime(NULL), nodesUpdated(NULL), sceneBacklog(NULL), allocations(NULL)
+{
+	for (int i = 0; i < SNAPSHOT_COUNT; i++) {
+		snapshots[i] = new WorldGraph;
+	}
+}
+
+GraphicsImpl::~GraphicsImpl()
 {
+	for (int i = 0; i < SNAPSHOT_COUNT; i++) {
+		delete snapshots[i];
+	}
+
+	delete allocations;
 }
 
 bool GraphicsImpl::doStep()
 {
-	if (newWorld) {
-		boost::mutex::scoped_lock lock(worldMutex);
-		std::swap(frontWorld, backWorld);
-		newWorld = false;
+	{
+		boost::mutex::scoped_lock lock(inputMutex);
+		frameInput.swap(pendingInput);
 	}
 
-	gui->injectFrameEntered(timeSinceLastFrame());
+	if (gui) {
+		PROFILE_ZONE("graphics GUI");
+		gui->injectFrameEntered(timeSinceLastFrame());
+	}
 
+	frameTime->observe(timeSinceLastFrame());
 	moveScale = timeSinceLastFrame() * 100;
 	camera->moveRelative(movementVector * moveScale);
-	updatePositions();
+
+	if (frameTimings) {
+		frameTimings->beginUpdate();
+		updatePositions();
+		frameTimings->endUpdate();
+	} else {
+		updatePositions();
+	}
+
 	Ogre::WindowEventUtilities::messagePump();
-	caelumSystem->notifyCameraChanged(camera);
-	return root->renderOneFrame();
+	if (caelumSystem) {
+		// following the camera has to happen every frame, the rest of the sky is throttled
+		caelumSystem->notifyCameraChanged(camera);
+		skyScheduler->update(timeSinceLastFrame());
+	}
+
+	bool result;
+	{
+		PROFILE_ZONE("graphics renderOneFrame");
+		result = root->renderOneFrame();
+	}
+
+	// the buffers are swapped now, which is as close to the screen as we can measure
+	if (!frameInput.empty()) {
+		double presented = monotonicTime();
+
+		for (std::vector<double>::const_iterator it = frameInput.begin(); it != frameInput.end(); ++it) {
+			LatencyTracker::Instance().addSample("input to present", presented - *it);
+		}
+
+		frameInput.clear();
+	}
+
+	if (headless) {
+		headlessDuration -= timeSinceLastFrame();
+
+		if (headlessDuration < 0) {
+			headlessDuration = std::numeric_limits<double>::max();
+			InformationManager::Instance()->postDataToFeed("gui_event", DataContainer(EXIT_BUTTON));
+		}
+	} else if (!caelumSystem) {
+		// the menu doesn't need the sky, so it's only created once the first frame is shown
+		StartupPhase phase("graphics: create sky");
+		createSky();
+	}
+
+	return result;
 }
 
 void GraphicsImpl::threadWillStart()
 {
+	Profiler::Instance().nameThread("graphics");
+	Metrics& metrics = Metrics::Instance();
+	frameTime = &metrics.histogram("graphics_frame_seconds", "Time between two rendered frames", Histogram::exponentialBounds(0.002, 2.0, 8));
+	nodesUpdated = &metrics.gauge("graphics_nodes_updated", "Scene nodes and instances moved in the last frame");
+	sceneBacklog = &metrics.gauge("graphics_scene_commands_queued", "Scene changes waiting for the per frame budget");
+	allocations = new FrameAllocations("graphics", false, boost::any_cast<int>(SettingsManager::Instance().getSetting("assert_no_allocations").data) != 0);
 	subscribeToFeed("input_keyboard", boost::bind(&GraphicsImpl::handleKeyEvents, this, _1));
 	subscribeToFeed("input_mouse", boost::bind(&GraphicsImpl::handleMouseEvents, this, _1));
 	subscribeToFeed("world_dynamic", boost::bind(&GraphicsImpl::handleWorldEvents, this, _1));
 	subscribeToFeed("create_object", boost::bind(&GraphicsImpl::handleObjectEvents, this, _1));
 	subscribeToFeed("create_terrain", boost::bind(&GraphicsImpl::handleTerrainEvents, this, _1));
 	subscribeToFeed("world_removed", boost::bind(&GraphicsImpl::handleRemovedObjects, this, _1));
+	subscribeToFeed("resource_loaded", boost::bind(&GraphicsImpl::handleResourceLoaded, this, _1));
 
-	Dout <<  "Creating root";
-	root = new Ogre::Root("", "", resourcePath + "ogre.log");
+	headless = boost::any_cast<int>(SettingsManager::Instance().getSetting("headless").data) != 0;
+	headlessDuration = boost::any_cast<int>(SettingsManager::Instance().getSetting("headless_duration").data);
 
-	Dout << "Loading plugins" ;
-	loadPlugins();
+	Dout <<  "Creating root";
+	{
+		StartupPhase phase("graphics: create root");
+		root = new Ogre::Root("", "", resourcePath + "ogre.log");
+	}
 
+	// resource locations don't depend on the render system, scan them while the window opens;
+	// only the files are read there, Ogre's ResourceGroupManager isn't thread safe during startup
 	Dout << "Setting Ressources" ;
-	setupResources();
+	boost::thread resourceScan(boost::bind(&GraphicsImpl::scanResources, this));
+
+	Dout << "Loading plugins" ;
+	{
+		StartupPhase phase("graphics: load plugins");
+		loadPlugins();
+	}
 
 	Dout << "Configuring root" ;
+	{
+		StartupPhase phase("graphics: configure and open window");
 
-	if (!configure()) {
-		Derr << "Failed to configure root";
+		if (!configure()) {
+			Derr << "Failed to configure root";
+		}
 	}
 
+	// input only needs the window handle, let it set up while we continue
+	InformationManager::Instance()->offerData("window", this);
 
 	Dout << "Create Scenemanager" ;
+	{
+		StartupPhase phase("graphics: scene manager, camera and viewport");
+		chooseSceneManager();
 
-	chooseSceneManager();
-
-	Dout << "Create Camera" ;
-	createCamera();
+		Dout << "Create Camera" ;
+		createCamera();
 
-	Dout << "Create Viewport" ;
-	createViewports();
+		Dout << "Create Viewport" ;
+		createViewports();
+	}
 
 	Dout << "Set default MipMap lvl" ;
 	Ogre::TextureManager::getSingleton().setDefaultNumMipmaps(5);
@@ -195,29 +387,72 @@ void GraphicsImpl::threadWillStart()
 	Dout << "Create resource listeners" ;
 	createResourceListener();
 
+	{
+		StartupPhase phase("graphics: wait for resource scan");
+		resourceScan.join();
+	}
+	{
+		StartupPhase phase("graphics: register resource locations");
+		setupResources();
+	}
+
 	Dout << "Load resources" ;
-	loadResources();
+	{
+		StartupPhase phase("graphics: initialise resource groups");
+		loadResources();
+	}
 
-	Dout << "Setup GUI";
-	setupGUI();
+	if (!headless) {
+		Dout << "Setup GUI";
+		StartupPhase phase("graphics: setup gui");
+		setupGUI();
+	}
 
 	Dout << "Create Framelistener" ;
 	createFrameListener();
 
 	Dout << "Create Basic Scene" ;
-	createScene();
+	{
+		StartupPhase phase("graphics: create scene");
+		createScene();
+	}
+
+	instances = new InstanceBatcher(sceneMgr, boost::any_cast<int>(SettingsManager::Instance().getSetting("instancing_threshold").data), frameArena);
+	sceneBudget = boost::any_cast<int>(SettingsManager::Instance().getSetting("scene_budget_ms").data) / 1000.0;
+	lod = new LodManager(root, sceneMgr, boost::any_cast<int>(SettingsManager::Instance().getSetting("lod_distance").data), boost::any_cast<int>(SettingsManager::Instance().getSetting("impostor_distance").data));
 
 	root->clearEventTimes();
 
-	InformationManager::Instance()->offerData("window", this);
+	InformationManager::Instance()->offerData("graphics", this);
 }
 
 void GraphicsImpl::threadWillStop()
 {
+	Dout << "Input latency:\n" << LatencyTracker::Instance().summary();
+
+	// headless runs are for measuring, so they always leave a profile behind
+	if (headless && Profiler::Instance().writeChromeTrace("headless.trace.json")) {
+		Dout << "Wrote profile to headless.trace.json";
+	}
+
+	delete lod;
+	delete instances;
+	delete skyScheduler;
 	delete caelumSystem;
-	gui->shutdown();
-	delete gui;
+
+	if (gui) {
+		gui->shutdown();
+		delete gui;
+	}
+
 	delete listener;
+
+	if (frameTimings) {
+		root->removeFrameListener(frameTimings);
+		frameTimings->report();
+		delete frameTimings;
+	}
+
 	//Ogre::WindowEventUtilities::removeWindowEventListener(window, this);
 	//windowClosed(window);
 
@@ -231,7 +466,10 @@ void GraphicsImpl::handleKeyEvents(const DataContainer& data)
 	InputKeyboardEvent ev = boost::any_cast<InputKeyboardEvent>(data.data);
 
 	if (ev.action == BUTTON_PRESSED) {
-		gui->injectKeyPress((MyGUI::KeyCode::Enum) ev.type);
+		// there is no gui in headless mode
+		if (gui) {
+			gui->injectKeyPress((MyGUI::KeyCode::Enum) ev.type);
+		}
 
 		if (ev.type == KEY_W) {
 			movementVector.z = -1;
@@ -251,7 +489,9 @@ void GraphicsImpl::handleKeyEvents(const DataContainer& data)
 	}
 
 	else {
-		gui->injectKeyRelease((MyGUI::KeyCode::Enum) ev.type);
+		if (gui) {
+			gui->injectKeyRelease((MyGUI::KeyCode::Enum) ev.type);
+		}
 
 		if (ev.type == KEY_W) {
 			movementVector.z = 0;
@@ -269,6 +509,14 @@ void GraphicsImpl::handleKeyEvents(const DataContainer& data)
 			movementVector.x = 0;
 		}
 	}
+
+	noteInput(ev.captured);
+}
+
+void GraphicsImpl::noteInput(double captured)
+{
+	boost::mutex::scoped_lock lock(inputMutex);
+	pendingInput.push_back(captured);
 }
 
 void GraphicsImpl::handleMouseEvents(const DataContainer& data)
@@ -276,7 +524,9 @@ void GraphicsImpl::handleMouseEvents(const DataContainer& data)
 	InputMouseEvent ev = boost::any_cast<InputMouseEvent>(data.data);
 	static bool mouseButtonPressed = false;
 
-	gui->injectMouseMove(ev.mouseX, ev.mouseY, 0);
+	if (gui) {
+		gui->injectMouseMove(ev.mouseX, ev.mouseY, 0);
+	}
 	camera->yaw(Ogre::Degree(-ev.mouseDeltaX * 0.13));
 	camera->pitch(Ogre::Degree(-ev.mouseDeltaY * 0.13));
 
@@ -299,43 +549,122 @@ void GraphicsImpl::handleMouseEvents(const DataContainer& data)
 
 		if (ev.action == BUTTON_PRESSED) {
 			mouseButtonPressed = true;
-			gui->injectMousePress(ev.mouseX, ev.mouseY, id);
+			if (gui) {
+				gui->injectMousePress(ev.mouseX, ev.mouseY, id);
+			}
 		}
 
 		else {
 			mouseButtonPressed = false;
-			gui->injectMouseRelease(ev.mouseX, ev.mouseY, id);
+			if (gui) {
+				gui->injectMouseRelease(ev.mouseX, ev.mouseY, id);
+			}
 		}
 	
+	noteInput(ev.captured);
 }
 
 void GraphicsImpl::handleObjectEvents(const DataContainer& data)
 {
 	boost::shared_ptr<ObjectToCreate> node = boost::any_cast< boost::shared_ptr<ObjectToCreate> >(data.data);
-	boost::mutex::scoped_lock lock(modifyNodesMutex);
-	nodesToAdd.push_back(node);
+
+	SceneCommand command;
+	command.type = SceneCommand::ADD_OBJECT;
+	command.object = node;
+
+	boost::mutex::scoped_lock lock(resourceMutex);
+	queueWhenLoaded(node->specification, ResourceManager::Instance().requestResource(node->specification, RESOURCE_PRIORITY_LOW), command);
+}
+
+void GraphicsImpl::queueWhenLoaded(const std::string& specification, const ResourceHandle& resource, const SceneCommand& command)
+{
+	// resourceMutex is held, so handleResourceLoaded can't run between isReady and parking the command
+	if (resource->isReady()) {
+		sceneCommands.push(command);
+	} else {
+		waitingForResource[specification].push_back(command);
+	}
 }
 
 void GraphicsImpl::handleRemovedObjects(const DataContainer& data)
 {
 	int node = boost::any_cast<int>(data.data);
-	boost::mutex::scoped_lock lock(modifyNodesMutex);
-	nodesToRemove.push_back(node);
+
+	{
+		// objects removed before their mesh arrived must not be created later
+		boost::mutex::scoped_lock lock(resourceMutex);
+
+		for (std::map< std::string, std::vector<SceneCommand> >::iterator it = waitingForResource.begin(); it != waitingForResource.end(); ++it) {
+			for (std::vector<SceneCommand>::iterator waiting = it->second.begin(); waiting != it->second.end(); ) {
+				int ID = (waiting->type == SceneCommand::ADD_OBJECT) ? waiting->object->node.ID : waiting->terrain->node.ID;
+
+				if (ID == node) {
+					waiting = it->second.erase(waiting);
+				} else {
+					++waiting;
+				}
+			}
+		}
+	}
+
+	SceneCommand command;
+	command.type = SceneCommand::REMOVE_OBJECT;
+	command.ID = node;
+	sceneCommands.push(command);
 }
 
 void GraphicsImpl::handleTerrainEvents(const DataContainer& data)
 {
-	Terrain object = boost::any_cast<Terrain>(data.data);
-	boost::mutex::scoped_lock lock(modifyNodesMutex);
-	terrainToCreate.push_back(object);
+	TerrainList terrain = boost::any_cast<TerrainList>(data.data);
+	std::map<std::string, ResourceHandle> requested;
+	boost::mutex::scoped_lock lock(resourceMutex);
+
+	for (std::vector<Terrain>::const_iterator it = terrain->begin(); it != terrain->end(); ++it) {
+		std::map<std::string, ResourceHandle>::iterator handle = requested.find(it->specification);
+
+		if (handle == requested.end()) {
+			handle = requested.insert(std::make_pair(it->specification, ResourceManager::Instance().requestResource(it->specification, RESOURCE_PRIORITY_NORMAL))).first;
+		}
+
+		SceneCommand command;
+		command.type = SceneCommand::CREATE_TERRAIN;
+		command.terrain.reset(new Terrain(*it));
+
+		queueWhenLoaded(it->specification, handle->second, command);
+	}
+}
+
+void GraphicsImpl::handleResourceLoaded(const DataContainer& data)
+{
+	// called on a ResourceManager worker
+	std::string name = boost::any_cast<std::string>(data.data);
+	boost::mutex::scoped_lock lock(resourceMutex);
+	std::map< std::string, std::vector<SceneCommand> >::iterator it = waitingForResource.find(name);
+
+	if (it == waitingForResource.end()) {
+		return;
+	}
+
+	for (std::vector<SceneCommand>::const_iterator command = it->second.begin(); command != it->second.end(); ++command) {
+		sceneCommands.push(*command);
+	}
+
+	waitingForResource.erase(it);
 }
 
 void GraphicsImpl::handleWorldEvents(const DataContainer& data)
 {
+	WorldGraph* world = boost::any_cast<WorldGraph*>(data.data);
 	boost::mutex::scoped_lock lock(worldMutex);
-	delete backWorld;
-	backWorld = new WorldGraph(boost::any_cast<WorldGraph*>(data.data));
-	newWorld = true;
+
+	// physics posts its graph even if it didn't step, only new simulation times are worth keeping
+	if (snapshotCount > 0 && world->time <= snapshots[newestSnapshot]->time) {
+		return;
+	}
+
+	newestSnapshot = (newestSnapshot + 1) % SNAPSHOT_COUNT;
+	*snapshots[newestSnapshot] = *world;
+	snapshotCount = std::min(snapshotCount + 1, SNAPSHOT_COUNT);
 }
 
 DataContainer GraphicsImpl::getData(const DataIdentifier& id)
@@ -349,6 +678,10 @@ DataContainer GraphicsImpl::getData(const DataIdentifier& id)
 		return DataContainer(windowHndStr.str());
 	}
 
+	if (id == "graphics.scene_backlog") {
+		return DataContainer(sceneCommands.size());
+	}
+
 	return DataContainer();
 }
 
@@ -359,35 +692,61 @@ void GraphicsImpl::loadPlugins()
 	root->loadPlugin("./Plugin_ParticleFX");
 }
 
-void GraphicsImpl::setupResources()
+void GraphicsImpl::scanResources()
 {
-	// Load resource paths from config file
-	Ogre::ConfigFile cf;
-	cf.load(resourcePath + "resources.cfg");
+	StartupPhase phase("graphics: scan resource locations");
 
-	// Go through all sections & settings in the file
-	Ogre::ConfigFile::SectionIterator seci = cf.getSectionIterator();
+	try {
+		// Load resource paths from config file
+		Ogre::ConfigFile cf;
+		cf.load(resourcePath + "resources.cfg");
 
-	Ogre::String secName, typeName, archName;
+		// Go through all sections & settings in the file
+		Ogre::ConfigFile::SectionIterator seci = cf.getSectionIterator();
 
-	while (seci.hasMoreElements()) {
-		secName = seci.peekNextKey();
-		Ogre::ConfigFile::SettingsMultiMap *settings = seci.getNext();
-		Ogre::ConfigFile::SettingsMultiMap::iterator i;
+		while (seci.hasMoreElements()) {
+			ResourceLocation location;
+			location.group = seci.peekNextKey();
+			Ogre::ConfigFile::SettingsMultiMap *settings = seci.getNext();
+			Ogre::ConfigFile::SettingsMultiMap::iterator i;
 
-		for (i = settings->begin(); i != settings->end(); ++i) {
-			typeName = i->first;
-			archName = i->second;
+			for (i = settings->begin(); i != settings->end(); ++i) {
+				location.type = i->first;
 #if OGRE_PLATFORM == OGRE_PLATFORM_APPLE
-			// OS X does not set the working directory relative to the app,
-			// In order to make things portable on OS X we need to provide
-			// the loading with it's own bundle path location
-			Ogre::ResourceGroupManager::getSingleton().addResourceLocation(
-			 Ogre::String(macBundlePath() + "/" + archName), typeName, secName);
+				// OS X does not set the working directory relative to the app,
+				// In order to make things portable on OS X we need to provide
+				// the loading with it's own bundle path location
+				location.name = Ogre::String(macBundlePath() + "/" + i->second);
 #else
-			Ogre::ResourceGroupManager::getSingleton().addResourceLocation(
-			 archName, typeName, secName);
+				location.name = i->second;
 #endif
+				resourceLocations.push_back(location);
+			}
+		}
+	} catch (Ogre::Exception& ex) {
+		Derr << ex.getFullDescription();
+	}
+
+	// listing the directories is what takes long, Ogre finds their entries cached when it indexes them
+	for (size_t i = 0; i < resourceLocations.size(); i++) {
+		if (resourceLocations[i].type != "FileSystem") {
+			continue;
+		}
+		boost::system::error_code error;
+		boost::filesystem::directory_iterator end;
+		for (boost::filesystem::directory_iterator entry(resourceLocations[i].name, error); !error && entry != end; entry.increment(error)) {
+		}
+	}
+}
+
+void GraphicsImpl::setupResources()
+{
+	for (size_t i = 0; i < resourceLocations.size(); i++) {
+		try {
+			Ogre::ResourceGroupManager::getSingleton().addResourceLocation(
+			 resourceLocations[i].name, resourceLocations[i].type, resourceLocations[i].group);
+		} catch (Ogre::Exception& ex) {
+			Derr << ex.getFullDescription();
 		}
 	}
 }
@@ -411,7 +770,23 @@ bool GraphicsImpl::configure()
 
 	Dout <<"Create window" ;
 
-	window = root->createRenderWindow("Manual Ogre Window", boost::any_cast<int>(SettingsManager::Instance().getSetting("x_res").data), boost::any_cast<int>(SettingsManager::Instance().getSetting("y_res").data), false, 0);                      // use defaults for all other values
+	int width = boost::any_cast<int>(SettingsManager::Instance().getSetting("x_res").data);
+	int height = boost::any_cast<int>(SettingsManager::Instance().getSetting("y_res").data);
+
+	if (headless) {
+		// GL still needs a window for its context, but it's never drawn to
+		Ogre::NameValuePairList params;
+		params["border"] = "none";
+		params["vsync"] = "false";
+		window = root->createRenderWindow("Headless Ogre Window", 1, 1, false, &params);
+		window->setAutoUpdated(false);
+
+		Ogre::TexturePtr texture = Ogre::TextureManager::getSingleton().createManual("HeadlessTarget", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, width, height, 0, Ogre::PF_R8G8B8, Ogre::TU_RENDERTARGET);
+		renderTarget = texture->getBuffer()->getRenderTarget();
+	} else {
+		window = root->createRenderWindow("Manual Ogre Window", width, height, false, 0);                      // use defaults for all other values
+		renderTarget = window;
+	}
 
 
 	return true;
@@ -435,7 +810,7 @@ void GraphicsImpl::createCamera()
 
 void GraphicsImpl::createViewports()
 {
-	viewPort = window->addViewport(camera);
+	viewPort = renderTarget->addViewport(camera);
 	viewPort->setBackgroundColour(Ogre::ColourValue(0,0,0));
 	camera->setAspectRatio(Ogre::Real(viewPort->getActualWidth()) / Ogre::Real(viewPort->getActualHeight()));
 }
@@ -451,6 +826,12 @@ void GraphicsImpl::loadResources()
 
 void GraphicsImpl::createFrameListener()
 {
+	if (headless) {
+		frameTimings = new FrameTimings(5.0);
+		root->addFrameListener(frameTimings);
+		return;
+	}
+
 	listener = new MyFrameListener(window, camera, sceneMgr);
 	listener->showDebugOverlay(true);
 	root->addFrameListener(listener);
@@ -472,7 +853,10 @@ void GraphicsImpl::createScene()
 	// Create a light
 	Ogre::Light* l = sceneMgr->createLight("MainLight");
 	l->setPosition(20,80,50);
+}
 
+void GraphicsImpl::createSky()
+{
 	caelumSystem = new Caelum::CaelumSystem(root, sceneMgr, Caelum::CaelumSystem::CAELUM_COMPONENTS_NONE);
 
 	try {
@@ -506,8 +890,7 @@ void GraphicsImpl::createScene()
 	}
 
 	// Register caelum.
-	// Don't make it a frame listener; update it by hand.
-	//Root::getSingletonPtr ()->addFrameListener (caelumSystem.get ());
+	// Don't make it a frame listener; skyScheduler updates it by hand.
 	caelumSystem->attachViewport(viewPort);
 
 	try {
@@ -564,9 +947,37 @@ void GraphicsImpl::createScene()
 
 	caelumSystem->getUniversalClock()->setTimeScale(1024);
 
-	window->addListener(caelumSystem);
+	skyScheduler = new CaelumScheduler(caelumSystem, boost::any_cast<int>(SettingsManager::Instance().getSetting("sky_update_rate").data));
+}
 
-	root->addFrameListener(caelumSystem);
+void GraphicsImpl::addNodes(const std::vector< boost::shared_ptr<ObjectToCreate> >& objects)
+{
+	std::map< std::string, std::vector< boost::shared_ptr<ObjectToCreate> > > bySpecification;
+
+	for (std::vector< boost::shared_ptr<ObjectToCreate> >::const_iterator iter = objects.begin(); iter != objects.end(); ++iter) {
+		bySpecification[(*iter)->specification].push_back(*iter);
+	}
+
+	for (std::map< std::string, std::vector< boost::shared_ptr<ObjectToCreate> > >::iterator iter = bySpecification.begin(); iter != bySpecification.end(); ++iter) {
+		// instanced batches copy the LOD levels of the mesh, so they have to exist before
+		lod->prepareMesh(iter->first);
+		instances->addObjects(iter->first, iter->second);
+
+		for (InstanceBatcher::ObjectList::iterator object = iter->second.begin(); object != iter->second.end(); ++object) {
+			RenderHandle handle;
+
+			if (!instances->getHandle((*object)->node.ID, handle)) {
+				addNode(*object);
+				continue;
+			}
+
+			size_t row = entities.add((*object)->node.ID, COMPONENT_TRANSFORM | COMPONENT_RENDER);
+			Archetype* entity = entities.find((*object)->node.ID, row);
+			entity->transforms[row].pos = (*object)->node.pos;
+			entity->transforms[row].orient = (*object)->node.orient;
+			entity->renderHandles[row] = handle;
+		}
+	}
 }
 
 void GraphicsImpl::addNode(const boost::shared_ptr<ObjectToCreate>& object)
@@ -581,12 +992,32 @@ void GraphicsImpl::addNode(const boost::shared_ptr<ObjectToCreate>& object)
 	node->setPosition(object->node.pos);
 	node->setOrientation(object->node.orient);
 	node->setScale(object->scale);
-	nodes[object->node.ID] = node;
+	lod->addObject(object->node.ID, node, object->specification);
+
+	size_t row = entities.add(object->node.ID, COMPONENT_TRANSFORM | COMPONENT_RENDER);
+	Archetype* entity = entities.find(object->node.ID, row);
+	entity->transforms[row].pos = object->node.pos;
+	entity->transforms[row].orient = object->node.orient;
+	entity->renderHandles[row].node = node;
 }
 
 void GraphicsImpl::removeNode(int ID)
 {
-	Ogre::SceneNode* node = nodes[ID];
+	size_t row;
+	Archetype* entity = entities.find(ID, row);
+
+	if (entity == NULL) {
+		return;
+	}
+
+	Ogre::SceneNode* node = entity->renderHandles[row].node;
+	entities.remove(ID);
+
+	if (instances->removeObject(ID)) {
+		return;
+	}
+
+	lod->removeObject(ID);
 
 	if (node->getParent() != NULL) {
 		node->getParent()->removeChild(node);
@@ -595,7 +1026,6 @@ void GraphicsImpl::removeNode(int ID)
 	node->removeAndDestroyAllChildren();
 
 	delete node;
-	nodes.erase(ID);
 }
 
 void GraphicsImpl::windowResized(Ogre::RenderWindow* rw)
@@ -619,44 +1049,202 @@ bool GraphicsImpl::windowClosing(Ogre::RenderWindow* rw)
 
 void GraphicsImpl::updatePositions()
 {
-	{
-		boost::mutex::scoped_lock lock(modifyNodesMutex);
+	PROFILE_ZONE("graphics updatePositions");
+	allocations->begin();
+	bool changed = applySceneCommands();
+	interpolateSnapshots();
+	instances->updateBounds();
+	lod->update(camera->getDerivedPosition());
+	updateDebugText();
+	frameArena.reset();
+	allocations->end(!changed && sceneCommands.size() == 0);
+}
+
+bool GraphicsImpl::applySceneCommands()
+{
+	Timer timer;
+	std::vector< boost::shared_ptr<ObjectToCreate> > objects;
+	SceneCommand command;
+	bool applied = false;
+
+	// whatever doesn't fit into the budget stays queued for the next frame
+	while (timer.time() < sceneBudget && sceneCommands.pop(command)) {
+		applied = true;
+
+		if (command.type == SceneCommand::ADD_OBJECT) {
+			// collect adds, so objects sharing a mesh can be instanced together
+			objects.push_back(command.object);
+
+			if (objects.size() < InstanceBatcher::MAX_INSTANCES_PER_BATCH) {
+				continue;
+			}
+		}
 
-		while (!nodesToAdd.empty()) {
-			addNode(nodesToAdd.back());
-			nodesToAdd.pop_back();
+		if (!objects.empty()) {
+			addNodes(objects);
+			objects.clear();
 		}
 
-		while (!nodesToRemove.empty()) {
-			removeNode(nodesToRemove.back());
-			nodesToRemove.pop_back();
+		if (command.type == SceneCommand::REMOVE_OBJECT) {
+			removeNode(command.ID);
+		} else if (command.type == SceneCommand::CREATE_TERRAIN) {
+			createTerrain(*command.terrain);
 		}
+	}
+
+	if (!objects.empty()) {
+		addNodes(objects);
+	}
+
+	sceneBacklog->set(sceneCommands.size());
+	return applied;
+}
+
+void GraphicsImpl::updateDebugText()
+{
+	if (!listener) {
+		return;
+	}
+
+	// only rebuilt when there is something new to show
+	unsigned long samples = LatencyTracker::Instance().getSampleCount();
+
+	if (samples == debugSamples && sceneCommands.size() == debugBacklog) {
+		return;
+	}
+
+	debugSamples = samples;
+	debugBacklog = sceneCommands.size();
+	LatencyTracker::Instance().summary(debugText);
+
+	if (sceneCommands.size() > 0) {
+		char queued[64];
+		std::snprintf(queued, sizeof(queued), "Scene commands queued: %lu\n", (unsigned long)sceneCommands.size());
+		debugText.insert(0, queued);
+	}
+
+	listener->setDebugText(debugText);
+}
+
+void GraphicsImpl::createTerrain(const Terrain& terrain)
+{
+	Ogre::Entity* ent;
+	Ogre::SceneNode* node;
+	Dout << "Creating terrain with specification: " + terrain.specification;
+	ent = sceneMgr->createEntity(ObjectRegistry::Instance().getNameForID(terrain.node.ID) + boost::lexical_cast<std::string>(terrain.node.ID), terrain.specification);
+
+	node = sceneMgr->getRootSceneNode()->createChildSceneNode();
+	node->attachObject(ent);
+	node->setPosition(terrain.node.pos);
+	ent->setMaterialName("Simple/BeachStones");
+	node->setOrientation(terrain.node.orient);
+	node->setScale(terrain.scale);
+
+	// terrain never moves, so it has no transform and applySnapshot skips it
+	size_t row = entities.add(terrain.node.ID, COMPONENT_RENDER);
+	entities.find(terrain.node.ID, row)->renderHandles[row].node = node;
+}
+
+void GraphicsImpl::interpolateSnapshots()
+{
+	boost::mutex::scoped_lock lock(worldMutex);
 
-		while (!terrainToCreate.empty()) {
-			Terrain terrain = terrainToCreate.back();
+	if (snapshotCount == 0) {
+		return;
+	}
 
-			Ogre::Entity* ent;
-			Ogre::SceneNode* node;
-			Dout << "Creating terrain with specification: " + terrain.specification;
-			ent = sceneMgr->createEntity(ObjectRegistry::Instance().getNameForID(terrain.node.ID) + boost::lexical_cast<std::string>(terrain.node.ID), terrain.specification);
+	WorldGraph* newest = snapshots[newestSnapshot];
 
-			node = sceneMgr->getRootSceneNode()->createChildSceneNode();
-			node->attachObject(ent);
-			node->setPosition(terrain.node.pos);
-			ent->setMaterialName("Simple/BeachStones");
-			node->setOrientation(terrain.node.orient);
-			node->setScale(terrain.scale);
-			nodes[terrain.node.ID] = node;
+	if (snapshotCount == 1) {
+		applySnapshot(*newest, *newest, 0);
+		return;
+	}
 
-			terrainToCreate.pop_back();
+	// render one physics tick behind the newest snapshot, so there is always a pair around renderTime
+	WorldGraph* previous = snapshots[(newestSnapshot + SNAPSHOT_COUNT - 1) % SNAPSHOT_COUNT];
+	double tick = newest->time - previous->time;
+	double target = newest->time - tick;
+
+	renderTime += timeSinceLastFrame();
+
+	if (std::abs(renderTime - target) > tick) {
+		// after a hitch on either side, just jump
+		renderTime = target;
+	} else {
+		// otherwise drift towards the target slowly, so frame times don't show up as jitter
+		renderTime += (target - renderTime) * 0.1;
+	}
 
+	int later = newestSnapshot;
+
+	for (int i = 1; i < snapshotCount; i++) {
+		int earlier = (later + SNAPSHOT_COUNT - 1) % SNAPSHOT_COUNT;
+
+		if (snapshots[earlier]->time <= renderTime) {
+			double t = (renderTime - snapshots[earlier]->time) / (snapshots[later]->time - snapshots[earlier]->time);
+			applySnapshot(*snapshots[earlier], *snapshots[later], std::min(t, 1.0));
+			return;
 		}
+
+		later = earlier;
 	}
 
-	if (!frontWorld->nodes.empty()) {
-		for (std::vector< OgreNewt::Node* >::iterator iter = frontWorld->nodes.begin(); iter != frontWorld->nodes.end(); ++iter) {
-			nodes[(*iter)->ID]->setOrientation((*iter)->orient);
-			nodes[(*iter)->ID]->setPosition((*iter)->pos);
+	// renderTime is older than anything we kept
+	applySnapshot(*snapshots[later], *snapshots[later], 0);
+}
+
+void GraphicsImpl::applySnapshot(const WorldGraph& from, const WorldGraph& to, Ogre::Real t)
+{
+	// the maths is spread over the job system, Ogre itself is only touched from this thread
+	interpolateFrom = &from;
+	interpolateTo = &to;
+	interpolateT = t;
+	JobSystem::Instance().parallelFor(0, to.size(), 256, boost::bind(&GraphicsImpl::interpolateRange, this, _1, _2));
+
+	entities.query(COMPONENT_TRANSFORM | COMPONENT_RENDER, moving);
+	size_t updated = 0;
+
+	for (std::vector<Archetype*>::iterator archetype = moving.begin(); archetype != moving.end(); ++archetype) {
+		const std::vector<Transform>& transforms = (*archetype)->transforms;
+		const std::vector<RenderHandle>& handles = (*archetype)->renderHandles;
+
+		for (size_t i = 0; i < transforms.size(); i++) {
+			if (handles[i].node) {
+				handles[i].node->setOrientation(transforms[i].orient);
+				handles[i].node->setPosition(transforms[i].pos);
+			} else {
+				instances->setTransform(handles[i], transforms[i].pos, transforms[i].orient);
+			}
+		}
+
+		updated += transforms.size();
+	}
+
+	nodesUpdated->set(updated);
+}
+
+void GraphicsImpl::interpolateRange(size_t first, size_t last)
+{
+	const WorldGraph& from = *interpolateFrom;
+	const WorldGraph& to = *interpolateTo;
+	Ogre::Real t = interpolateT;
+
+	for (size_t i = first; i < last; i++) {
+		size_t row;
+		Archetype* entity = entities.find(to.ids[i], row);
+
+		// the object may still be waiting in sceneCommands
+		if (entity == NULL || !entity->has(COMPONENT_TRANSFORM)) {
+			continue;
+		}
+
+		Transform& transform = entity->transforms[row];
+		transform = to.transforms[i];
+
+		// physics only appends to its arrays while nothing is removed, so an object normally keeps its index between snapshots
+		if (i < from.size() && from.ids[i] == to.ids[i]) {
+			transform.pos = from.transforms[i].pos + (to.transforms[i].pos - from.transforms[i].pos) * t;
+			transform.orient = Ogre::Quaternion::Slerp(t, from.transforms[i].orient, to.transforms[i].orient, true);
 		}
 	}
 }
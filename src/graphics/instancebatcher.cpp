@@ -0,0 +1,255 @@
+//
+// C++ Implementation: instancebatcher
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "instancebatcher.h"
+#include <taskengine/taskengine.h>
+#include "boost/lexical_cast.hpp"
+
+static const char* INSTANCING_PROGRAM = "OTE/InstancingVP";
+
+const size_t InstanceBatcher::MAX_INSTANCES_PER_BATCH;
+
+InstanceBatcher::InstanceBatcher(Ogre::SceneManager* sceneMgr, size_t threshold, FrameArena& arena) : sceneMgr(sceneMgr), threshold(threshold), programSupported(false), movedBatches(std::less<Ogre::InstancedGeometry::BatchInstance*>(), ArenaAllocator<Ogre::InstancedGeometry::BatchInstance*>(arena)), batchCounter(0)
+{
+	if (threshold == 0) {
+		return;
+	}
+
+	Ogre::HighLevelGpuProgramPtr program = Ogre::HighLevelGpuProgramManager::getSingleton().getByName(INSTANCING_PROGRAM);
+
+	if (program.isNull()) {
+		Dout << "Instancing disabled, vertex program " << INSTANCING_PROGRAM << " not found";
+		return;
+	}
+
+	try {
+		program->load();
+		programSupported = program->isSupported() && !program->hasCompileError();
+	} catch (Ogre::Exception& ex) {
+		Dout << ex.getFullDescription();
+	}
+
+	if (!programSupported) {
+		Dout << "Instancing disabled, vertex program " << INSTANCING_PROGRAM << " isn't supported";
+	}
+}
+
+InstanceBatcher::~InstanceBatcher()
+{
+	for (std::map<std::string, Group>::iterator it = groups.begin(); it != groups.end(); ++it) {
+		for (std::vector<Ogre::InstancedGeometry*>::iterator batch = it->second.batches.begin(); batch != it->second.batches.end(); ++batch) {
+			sceneMgr->destroyInstancedGeometry(*batch);
+		}
+	}
+}
+
+InstanceBatcher::ObjectList InstanceBatcher::addObjects(const std::string& specification, const ObjectList& toAdd)
+{
+	if (!programSupported) {
+		return toAdd;
+	}
+
+	Group& group = groups[specification];
+
+	// only spend a batch if enough objects come at once, a handful of unique props is cheaper as entities
+	if (group.supported && group.freeSlots.size() < toAdd.size() && toAdd.size() - group.freeSlots.size() >= threshold) {
+		createBatch(specification, group, toAdd.size() - group.freeSlots.size());
+	}
+
+	ObjectList rest;
+
+	for (ObjectList::const_iterator it = toAdd.begin(); it != toAdd.end(); ++it) {
+		if (group.freeSlots.empty()) {
+			rest.push_back(*it);
+			continue;
+		}
+
+		Slot slot = group.freeSlots.back();
+		group.freeSlots.pop_back();
+
+		slot.object->setPosition((*it)->node.pos);
+		slot.object->setOrientation((*it)->node.orient);
+		slot.object->setScale((*it)->scale);
+		movedBatches.insert(slot.owner);
+
+		objects[(*it)->node.ID] = slot;
+		objectSpecs[(*it)->node.ID] = specification;
+	}
+
+	return rest;
+}
+
+bool InstanceBatcher::removeObject(int ID)
+{
+	std::map<int, Slot>::iterator it = objects.find(ID);
+
+	if (it == objects.end()) {
+		return false;
+	}
+
+	// single instances can't be taken out of a built batch, so the slot is hidden and reused
+	hide(it->second);
+	groups[objectSpecs[ID]].freeSlots.push_back(it->second);
+	objects.erase(it);
+	objectSpecs.erase(ID);
+	return true;
+}
+
+bool InstanceBatcher::getHandle(int ID, RenderHandle& handle) const
+{
+	std::map<int, Slot>::const_iterator it = objects.find(ID);
+
+	if (it == objects.end()) {
+		return false;
+	}
+
+	handle.instance = it->second.object;
+	handle.batch = it->second.owner;
+	return true;
+}
+
+void InstanceBatcher::setTransform(const RenderHandle& handle, const Ogre::Vector3& pos, const Ogre::Quaternion& orient)
+{
+	handle.instance->setPosition(pos);
+	handle.instance->setOrientation(orient);
+	movedBatches.insert(handle.batch);
+}
+
+void InstanceBatcher::updateBounds()
+{
+	for (BatchSet::iterator it = movedBatches.begin(); it != movedBatches.end(); ++it) {
+		(*it)->updateBoundingBox();
+	}
+
+	movedBatches.clear();
+}
+
+size_t InstanceBatcher::getBatchCount() const
+{
+	size_t count = 0;
+
+	for (std::map<std::string, Group>::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+		for (std::vector<Ogre::InstancedGeometry*>::const_iterator batch = it->second.batches.begin(); batch != it->second.batches.end(); ++batch) {
+			Ogre::InstancedGeometry::BatchInstanceIterator instances = (*batch)->getBatchInstanceIterator();
+
+			while (instances.hasMoreElements()) {
+				instances.getNext();
+				++count;
+			}
+		}
+	}
+
+	return count;
+}
+
+bool InstanceBatcher::createBatch(const std::string& specification, Group& group, size_t count)
+{
+	std::string name = "instancing/" + specification + "/" + boost::lexical_cast<std::string>(batchCounter++);
+	Ogre::Entity* ent = sceneMgr->createEntity(name, specification);
+
+	// skeletal animation would need the bone matrices we use for the instances
+	if (ent->hasSkeleton() || !prepareMaterials(ent)) {
+		Dout << "Can't instance " << specification << ", using regular entities";
+		sceneMgr->destroyEntity(ent);
+		group.supported = false;
+		return false;
+	}
+
+	size_t batchSize = std::min(count, MAX_INSTANCES_PER_BATCH);
+	size_t batchInstances = (count + batchSize - 1) / batchSize;
+
+	Ogre::InstancedGeometry* batch = sceneMgr->createInstancedGeometry(name);
+	batch->setCastShadows(false);
+	// one region for the whole level, the objects are moved by physics anyway
+	batch->setBatchInstanceDimensions(Ogre::Vector3(1000000, 1000000, 1000000));
+
+	for (size_t i = 0; i < batchSize; i++) {
+		batch->addEntity(ent, Ogre::Vector3::ZERO);
+	}
+
+	batch->setOrigin(Ogre::Vector3::ZERO);
+	batch->build();
+
+	for (size_t i = 1; i < batchInstances; i++) {
+		batch->addBatchInstance();
+	}
+
+	sceneMgr->destroyEntity(ent);
+
+	Ogre::InstancedGeometry::BatchInstanceIterator instances = batch->getBatchInstanceIterator();
+
+	while (instances.hasMoreElements()) {
+		Ogre::InstancedGeometry::BatchInstance* instance = instances.getNext();
+		Ogre::InstancedGeometry::BatchInstance::InstancedObjectIterator objectIt = instance->getObjectIterator();
+
+		while (objectIt.hasMoreElements()) {
+			Slot slot;
+			slot.object = objectIt.getNext();
+			slot.owner = instance;
+			hide(slot);
+			group.freeSlots.push_back(slot);
+		}
+	}
+
+	group.batches.push_back(batch);
+
+	Dout << "Instancing " << count << " x " << specification << " in " << batchInstances << " batches";
+	return true;
+}
+
+bool InstanceBatcher::prepareMaterials(Ogre::Entity* ent)
+{
+	for (unsigned int i = 0; i < ent->getNumSubEntities(); i++) {
+		Ogre::SubEntity* sub = ent->getSubEntity(i);
+		std::string instancedName = sub->getMaterialName() + "/Instanced";
+
+		if (!Ogre::MaterialManager::getSingleton().resourceExists(instancedName)) {
+			Ogre::MaterialPtr original = sub->getMaterial();
+
+			// materials with their own vertex programs can't be combined with ours
+			for (unsigned short t = 0; t < original->getNumTechniques(); t++) {
+				Ogre::Technique* technique = original->getTechnique(t);
+
+				for (unsigned short p = 0; p < technique->getNumPasses(); p++) {
+					if (technique->getPass(p)->hasVertexProgram()) {
+						return false;
+					}
+				}
+			}
+
+			Ogre::MaterialPtr instanced = original->clone(instancedName);
+
+			for (unsigned short t = 0; t < instanced->getNumTechniques(); t++) {
+				Ogre::Technique* technique = instanced->getTechnique(t);
+
+				for (unsigned short p = 0; p < technique->getNumPasses(); p++) {
+					technique->getPass(p)->setVertexProgram(INSTANCING_PROGRAM);
+				}
+			}
+
+			instanced->load();
+		}
+
+		sub->setMaterialName(instancedName);
+	}
+
+	return true;
+}
+
+void InstanceBatcher::hide(const Slot& slot)
+{
+	// a zero scale is the hidden flag, OTE/InstancingVP moves such instances behind the far plane;
+	// they still cost vertices but no extra draw call. Moving them out of view instead would
+	// stretch the bounds of their batch.
+	slot.object->setScale(Ogre::Vector3::ZERO);
+	movedBatches.insert(slot.owner);
+}
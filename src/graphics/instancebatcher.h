@@ -0,0 +1,95 @@
+//
+// C++ Interface: instancebatcher
+//
+// Description: Renders many copies of the same mesh through Ogre::InstancedGeometry
+// instead of one entity and scene node per object.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#ifndef INSTANCEBATCHER_H
+#define INSTANCEBATCHER_H
+
+#include "Ogre.h"
+#include "FeedDataTypes.h"
+#include "entitystore.h"
+#include "allocationtracker.h"
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+/** Objects are grouped by their specification (mesh name). Once at least threshold objects
+ * of one mesh arrive together, they are put into an InstancedGeometry batch, which draws up to
+ * MAX_INSTANCES_PER_BATCH of them in one call per submesh; the transforms of all instances are
+ * uploaded as a matrix array to the OTE/InstancingVP vertex program.
+ * Unused slots of a batch are kept hidden with a zero scale, which the vertex program reads as
+ * invisible, and are handed out to later objects of the same mesh.
+ **/
+class InstanceBatcher
+{
+	public:
+		typedef std::vector< boost::shared_ptr<ObjectToCreate> > ObjectList;
+
+		/** has to match the size of worldMatrix3x4Array in Instancing.vert **/
+		static const size_t MAX_INSTANCES_PER_BATCH = 80;
+
+		/** a threshold of 0 disables instancing; arena must be reset only after updateBounds() **/
+		InstanceBatcher(Ogre::SceneManager* sceneMgr, size_t threshold, FrameArena& arena);
+		~InstanceBatcher();
+
+		/** instances as many of objects (which all share specification) as possible,
+		 * returns those which still need a regular entity
+		 **/
+		ObjectList addObjects(const std::string& specification, const ObjectList& objects);
+		/** returns false if ID isn't instanced **/
+		bool removeObject(int ID);
+		/** fills the instance fields of handle, returns false if ID isn't instanced **/
+		bool getHandle(int ID, RenderHandle& handle) const;
+		/** moves the instance of a handle filled by getHandle, valid until its object is removed **/
+		void setTransform(const RenderHandle& handle, const Ogre::Vector3& pos, const Ogre::Quaternion& orient);
+		/** refreshes the bounds of all batches moved since the last call, call once per frame **/
+		void updateBounds();
+
+		size_t getBatchCount() const;
+		size_t getInstanceCount() const { return objects.size(); }
+
+	private:
+		struct Slot
+		{
+			Ogre::InstancedGeometry::InstancedObject* object;
+			Ogre::InstancedGeometry::BatchInstance* owner;
+		};
+
+		struct Group
+		{
+			Group() : supported(true) { }
+
+			bool supported;
+			std::vector<Ogre::InstancedGeometry*> batches;
+			std::vector<Slot> freeSlots;
+		};
+
+		bool createBatch(const std::string& specification, Group& group, size_t count);
+		bool prepareMaterials(Ogre::Entity* ent);
+		void hide(const Slot& slot);
+
+		Ogre::SceneManager* sceneMgr;
+		size_t threshold;
+		bool programSupported;
+
+		std::map<std::string, Group> groups;
+		std::map<int, Slot> objects;
+		std::map<int, std::string> objectSpecs;
+		typedef std::set< Ogre::InstancedGeometry::BatchInstance*, std::less<Ogre::InstancedGeometry::BatchInstance*>, ArenaAllocator<Ogre::InstancedGeometry::BatchInstance*> > BatchSet;
+		/** only lives until the next updateBounds(), so its nodes come from the frame arena **/
+		BatchSet movedBatches;
+		int batchCounter;
+};
+
+#endif
@@ -18,9 +18,12 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 #include "listener.h"
+#include "metrics.h"
 
 using namespace OIS;
 
+const double MyFrameListener::METRICS_INTERVAL = 0.25;
+
 bool MyFrameListener::frameStarted(const Ogre::FrameEvent& evt)
 {
 
@@ -89,8 +92,16 @@ void MyFrameListener::updateStats()
 		Ogre::OverlayElement* guiBatches = Ogre::OverlayManager::getSingleton().getOverlayElement("Core/NumBatches");
 		guiBatches->setCaption(batches + Ogre::StringConverter::toString(stats.batchCount));
 
-		Ogre::OverlayElement* guiDbg = Ogre::OverlayManager::getSingleton().getOverlayElement("Core/DebugText");
-		guiDbg->setCaption(mDebugText);
+		// the metrics are read live, they are updated by the other threads without locks; a few times a second is enough to read them
+		if (mDebugTextChanged || mMetricsAge.time() > METRICS_INTERVAL)
+		{
+			mMetricsSummary = Metrics::Instance().summary();
+			mMetricsAge.reset();
+			mDebugTextChanged = false;
+
+			Ogre::OverlayElement* guiDbg = Ogre::OverlayManager::getSingleton().getOverlayElement("Core/DebugText");
+			guiDbg->setCaption(mDebugText + mMetricsSummary);
+		}
 	}
 	catch(...) { /* ignore */ }
 }
@@ -25,6 +25,7 @@
 #include "OgreStringConverter.h"
 #include "OgreException.h"
 #include <OgreNewt.h>
+#include "timer.h"
 
 //Use this define to signify OIS will be used as a DLL
 //(so that dll import/export macros are in effect)
@@ -39,7 +40,7 @@ class MyFrameListener : public Ogre::FrameListener, public Ogre::WindowEventList
 			bool bufferedJoy = false ) :
 			mCamera(cam), mTranslateVector(Ogre::Vector3::ZERO), mWindow(win), mStatsOn(true), mNumScreenShots(0),
 				mMoveScale(0.0f), mRotScale(0.0f), mTimeUntilNextToggle(0), mFiltering(Ogre::TFO_BILINEAR),
-					   mAniso(1), mSceneDetailIndex(0), mMoveSpeed(100), mRotateSpeed(36), mDebugOverlay(0)
+					   mAniso(1), mSceneDetailIndex(0), mMoveSpeed(100), mRotateSpeed(36), mDebugOverlay(0), mDebugTextChanged(true)
 					   {
 						   using namespace OIS;
 
@@ -56,6 +57,7 @@ class MyFrameListener : public Ogre::FrameListener, public Ogre::WindowEventList
 
 					   void moveCamera();
 					   void showDebugOverlay(bool show);
+					   void setDebugText(const std::string& text) { mDebugText = text; mDebugTextChanged = true; }
 					   bool frameStarted(const Ogre::FrameEvent& evt);
 					   bool frameEnded(const Ogre::FrameEvent& evt);
 
@@ -83,6 +85,13 @@ class MyFrameListener : public Ogre::FrameListener, public Ogre::WindowEventList
 		Ogre::Real mMoveSpeed;
 		Ogre::Degree mRotateSpeed;
 		Ogre::Overlay* mDebugOverlay;
+
+		/** seconds between two refreshes of the metrics on the overlay **/
+		static const double METRICS_INTERVAL;
+		/** Metrics::summary() as last shown, rebuilding it allocates **/
+		std::string mMetricsSummary;
+		Timer mMetricsAge;
+		bool mDebugTextChanged;
 };
 
 
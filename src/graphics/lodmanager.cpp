@@ -0,0 +1,205 @@
+//
+// C++ Implementation: lodmanager
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "lodmanager.h"
+#include <taskengine/taskengine.h>
+
+/** resolution of the impostor pictures **/
+static const unsigned int IMPOSTOR_SIZE = 128;
+
+LodManager::LodManager(Ogre::Root* root, Ogre::SceneManager* sceneMgr, Ogre::Real lodDistance, Ogre::Real impostorDistance) : root(root), sceneMgr(sceneMgr), impostorScene(NULL), lodDistance(lodDistance), impostorDistance(impostorDistance), cursor(0), impostorsShown(0)
+{
+}
+
+LodManager::~LodManager()
+{
+	for (std::map<std::string, Impostor>::iterator it = impostors.begin(); it != impostors.end(); ++it) {
+		sceneMgr->destroyBillboardSet(it->second.billboards);
+	}
+
+	if (impostorScene) {
+		root->destroySceneManager(impostorScene);
+	}
+}
+
+void LodManager::prepareMesh(const std::string& specification)
+{
+	if (prepared.find(specification) != prepared.end()) {
+		return;
+	}
+
+	prepared.insert(specification);
+
+	Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().load(specification, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+
+	// meshes exported with their own LOD levels keep them
+	if (lodDistance > 0 && mesh->getNumLodLevels() == 1) {
+		Ogre::Mesh::LodValueList distances;
+
+		for (int i = 1; i <= LOD_LEVELS; i++) {
+			distances.push_back(lodDistance * i);
+		}
+
+		// every level has half the vertices of the previous one
+		mesh->generateLodLevels(distances, Ogre::ProgressiveMesh::VRQ_PROPORTIONAL, 0.5);
+	}
+
+	if (impostorDistance > 0) {
+		createImpostor(specification, mesh);
+	}
+}
+
+void LodManager::createImpostor(const std::string& specification, Ogre::MeshPtr mesh)
+{
+	if (!impostorScene) {
+		impostorScene = root->createSceneManager(Ogre::ST_GENERIC, "ImpostorScene");
+		impostorScene->setAmbientLight(Ogre::ColourValue(0.5, 0.5, 0.5));
+		Ogre::Light* light = impostorScene->createLight("ImpostorLight");
+		light->setType(Ogre::Light::LT_DIRECTIONAL);
+		light->setDirection(Ogre::Vector3(-0.5, -1, -1).normalisedCopy());
+	}
+
+	std::string name = "Impostor/" + specification;
+	Ogre::Real radius = mesh->getBoundingSphereRadius();
+	Ogre::Vector3 center = mesh->getBounds().getCenter();
+
+	Ogre::TexturePtr texture = Ogre::TextureManager::getSingleton().createManual(name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, IMPOSTOR_SIZE, IMPOSTOR_SIZE, 0, Ogre::PF_A8R8G8B8, Ogre::TU_RENDERTARGET);
+	Ogre::RenderTexture* target = texture->getBuffer()->getRenderTarget();
+	target->setAutoUpdated(false);
+
+	Ogre::Entity* ent = impostorScene->createEntity(name, specification);
+	Ogre::SceneNode* node = impostorScene->getRootSceneNode()->createChildSceneNode();
+	node->attachObject(ent);
+
+	// look at the mesh from the front, the same way it is spawned
+	Ogre::Camera* camera = impostorScene->createCamera(name);
+	camera->setProjectionType(Ogre::PT_ORTHOGRAPHIC);
+	camera->setOrthoWindow(radius * 2, radius * 2);
+	camera->setNearClipDistance(radius * 0.1);
+	camera->setFarClipDistance(radius * 4);
+	camera->setPosition(center + Ogre::Vector3(0, 0, radius * 2));
+	camera->lookAt(center);
+
+	Ogre::Viewport* viewport = target->addViewport(camera);
+	viewport->setBackgroundColour(Ogre::ColourValue(0, 0, 0, 0));
+	viewport->setOverlaysEnabled(false);
+	viewport->setSkiesEnabled(false);
+	target->update();
+
+	target->removeAllViewports();
+	impostorScene->destroyCamera(camera);
+	impostorScene->destroyEntity(ent);
+	impostorScene->destroySceneNode(node);
+
+	Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create(name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	Ogre::Pass* pass = material->getTechnique(0)->getPass(0);
+	pass->setLightingEnabled(false);
+	pass->setAlphaRejectSettings(Ogre::CMPF_GREATER, 128);
+	pass->createTextureUnitState(name);
+
+	Impostor impostor;
+	impostor.billboards = sceneMgr->createBillboardSet(name);
+	impostor.billboards->setMaterialName(name);
+	impostor.billboards->setDefaultDimensions(radius * 2, radius * 2);
+	sceneMgr->getRootSceneNode()->attachObject(impostor.billboards);
+	impostor.radius = radius;
+	impostor.dirty = false;
+	impostors[specification] = impostor;
+
+	Dout << "Created impostor for " << specification;
+}
+
+void LodManager::addObject(int ID, Ogre::SceneNode* node, const std::string& specification)
+{
+	std::map<std::string, Impostor>::iterator impostor = impostors.find(specification);
+
+	if (impostor == impostors.end()) {
+		return;
+	}
+
+	LodObject object;
+	object.node = node;
+	object.impostor = &impostor->second;
+	object.size = impostor->second.radius * 2 * node->getScale().x;
+	// hidden until the object is far enough away
+	object.billboard = impostor->second.billboards->createBillboard(node->getPosition());
+	object.billboard->setDimensions(0, 0);
+	object.impostorShown = false;
+	objects[ID] = object;
+}
+
+void LodManager::removeObject(int ID)
+{
+	std::map<int, LodObject>::iterator it = objects.find(ID);
+
+	if (it == objects.end()) {
+		return;
+	}
+
+	if (it->second.impostorShown) {
+		impostorsShown--;
+		it->second.impostor->dirty = true;
+	}
+
+	it->second.impostor->billboards->removeBillboard(it->second.billboard);
+	objects.erase(it);
+}
+
+void LodManager::update(const Ogre::Vector3& cameraPos)
+{
+	if (objects.empty()) {
+		return;
+	}
+
+	// continue where the last frame stopped, wrapping around at the end
+	size_t budget = objects.size() / UPDATE_FRAMES + 1;
+	std::map<int, LodObject>::iterator it = objects.lower_bound(cursor);
+
+	for (size_t i = 0; i < budget && i < objects.size(); i++, ++it) {
+		if (it == objects.end()) {
+			it = objects.begin();
+		}
+
+		LodObject& object = it->second;
+		Ogre::Real distance = object.node->getPosition().distance(cameraPos);
+
+		// a little hysteresis, so objects right at the border don't flicker
+		bool impostor = distance > (object.impostorShown ? impostorDistance * 0.9 : impostorDistance);
+
+		if (impostor != object.impostorShown) {
+			object.impostorShown = impostor;
+			object.node->setVisible(!impostor);
+			object.billboard->setDimensions(impostor ? object.size : 0, impostor ? object.size : 0);
+			object.impostor->dirty = true;
+
+			if (impostor) {
+				impostorsShown++;
+			} else {
+				impostorsShown--;
+			}
+		}
+
+		if (impostor && object.billboard->getPosition() != object.node->getPosition()) {
+			object.billboard->setPosition(object.node->getPosition());
+			object.impostor->dirty = true;
+		}
+	}
+
+	cursor = (it == objects.end()) ? objects.begin()->first : it->first;
+
+	for (std::map<std::string, Impostor>::iterator set = impostors.begin(); set != impostors.end(); ++set) {
+		if (set->second.dirty) {
+			set->second.billboards->_updateBounds();
+			set->second.dirty = false;
+		}
+	}
+}
@@ -0,0 +1,84 @@
+//
+// C++ Interface: lodmanager
+//
+// Description: Distance based level of detail and billboard impostors for spawned objects.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#ifndef LODMANAGER_H
+#define LODMANAGER_H
+
+#include "Ogre.h"
+#include <string>
+#include <map>
+#include <set>
+
+/** The first time a mesh is used, prepareMesh generates LOD_LEVELS reduced versions of it,
+ * switched in at multiples of lodDistance from the camera. Objects further away than
+ * impostorDistance aren't drawn as meshes at all but as a billboard showing a picture of the
+ * mesh, rendered once per mesh; all impostors of one mesh share a single BillboardSet.
+ * update looks at a slice of the objects per frame, so every object is checked at least every
+ * UPDATE_FRAMES frames no matter how many there are.
+ **/
+class LodManager
+{
+	public:
+		static const int LOD_LEVELS = 2;
+		static const int UPDATE_FRAMES = 8;
+
+		/** an impostorDistance of 0 disables impostors **/
+		LodManager(Ogre::Root* root, Ogre::SceneManager* sceneMgr, Ogre::Real lodDistance, Ogre::Real impostorDistance);
+		~LodManager();
+
+		/** generates the LOD levels (and impostor) of specification, if that didn't happen yet **/
+		void prepareMesh(const std::string& specification);
+
+		/** node is switched to an impostor when far away, it has to stay valid until removeObject **/
+		void addObject(int ID, Ogre::SceneNode* node, const std::string& specification);
+		void removeObject(int ID);
+
+		/** switches the next slice of objects between meshes and impostors, call once per frame **/
+		void update(const Ogre::Vector3& cameraPos);
+
+		size_t getImpostorCount() const { return impostorsShown; }
+
+	private:
+		struct Impostor
+		{
+			Ogre::BillboardSet* billboards;
+			Ogre::Real radius;
+			/** a billboard moved or changed size, the bounds of the set need updating **/
+			bool dirty;
+		};
+
+		struct LodObject
+		{
+			Ogre::SceneNode* node;
+			Impostor* impostor;
+			Ogre::Billboard* billboard;
+			Ogre::Real size;
+			bool impostorShown;
+		};
+
+		void createImpostor(const std::string& specification, Ogre::MeshPtr mesh);
+
+		Ogre::Root* root;
+		Ogre::SceneManager* sceneMgr;
+		/** separate scene the impostor pictures are rendered in **/
+		Ogre::SceneManager* impostorScene;
+		Ogre::Real lodDistance, impostorDistance;
+
+		std::set<std::string> prepared;
+		std::map<std::string, Impostor> impostors;
+		std::map<int, LodObject> objects;
+		/** ID of the object the next update starts at **/
+		int cursor;
+		size_t impostorsShown;
+};
+
+#endif
@@ -13,6 +13,9 @@
 #include "input.h"
 #include "FeedDataTypes.h"
 #include "settingsmanager.h"
+#include "startupprofiler.h"
+#include "timer.h"
+#include "profiler.h"
 
 //Use this define to signify OIS will be used as a DLL
 //(so that dll import/export macros are in effect)
@@ -22,7 +25,7 @@
 class InputImpl : public Task, public OIS::MouseListener, public OIS::KeyListener
 {
 	public:
-		InputImpl() { }
+		InputImpl() : mInputManager(0), mMouse(0), mKeyboard(0), pollInterval(10), captureTime(0.0) { }
 		 // MouseListener
 		bool mouseMoved(const OIS::MouseEvent &e);
 		bool mousePressed(const OIS::MouseEvent &e, OIS::MouseButtonID id);
@@ -40,6 +43,10 @@ class InputImpl : public Task, public OIS::MouseListener, public OIS::KeyListene
 		OIS::Mouse*    mMouse;
 		OIS::Keyboard* mKeyboard;
 		InputMouseEvent lastMouseState;
+		/** OIS can only be polled, this is the longest a key press waits to be captured **/
+		int pollInterval;
+		/** stamped into every event found by the current capture **/
+		double captureTime;
 };
 
 Input::Input() : impl(new InputImpl) { }
@@ -50,20 +57,32 @@ void Input::threadWillStop() { impl->threadWillStop(); }
 
 bool InputImpl::doStep()
 {
-#ifndef DEBUG_BUILD
-	boost::this_thread::sleep(boost::posix_time::milliseconds(10));		// Wait 1/100 s
+	{
+		PROFILE_ZONE("input capture");
+		captureTime = monotonicTime();
+		if(mMouse)
+			mMouse->capture();
+		if(mKeyboard) 
+			mKeyboard->capture();
+	}
+#ifndef JOB_SYSTEM
+	// sleep after capturing, so events are posted right away and not one interval late
+	boost::this_thread::sleep(boost::posix_time::milliseconds(pollInterval));
 #endif
-	if(mMouse)
-		mMouse->capture();
-	if(mKeyboard) 
-		mKeyboard->capture();
 	return running;
 }
 
 void InputImpl::threadWillStart()
 {
+	Profiler::Instance().nameThread("input");
 	OIS::ParamList pl;
-	DataContainer myHandle = InformationManager::Instance()->requestData("window.handle", 10);
+	DataContainer myHandle;
+	{
+		StartupPhase phase("input: wait for window");
+		myHandle = InformationManager::Instance()->requestData("window.handle", 10);
+	}
+	StartupPhase phase("input: create devices");
+	pollInterval = boost::any_cast<int>(SettingsManager::Instance().getSetting("input_poll_ms").data);
 	pl.insert(std::make_pair(std::string("WINDOW"), boost::any_cast<std::string>(myHandle.data) ));
 	
 	{
@@ -109,6 +128,7 @@ bool InputImpl::mouseMoved(const OIS::MouseEvent &e)
 	lastMouseState.mouseX = e.state.X.abs;
 	lastMouseState.mouseY = e.state.Y.abs;
 	
+	lastMouseState.captured = captureTime;
 	InformationManager::Instance()->postDataToFeed( "input_mouse", DataContainer(lastMouseState) );
 	return true;
 }
@@ -129,6 +149,7 @@ bool InputImpl::mousePressed(const OIS::MouseEvent &e, OIS::MouseButtonID id)
 	{
 		lastMouseState.type = BUTTON_MOUSE_MIDDLE;
 	}
+	lastMouseState.captured = captureTime;
 	InformationManager::Instance()->postDataToFeed( "input_mouse", DataContainer(lastMouseState) );
 	return true;
 }
@@ -149,6 +170,7 @@ bool InputImpl::mouseReleased(const OIS::MouseEvent &e, OIS::MouseButtonID id)
 	{
 		lastMouseState.type = BUTTON_MOUSE_MIDDLE;
 	}
+	lastMouseState.captured = captureTime;
 	InformationManager::Instance()->postDataToFeed( "input_mouse", DataContainer(lastMouseState) );
 	return true;
 }
@@ -159,6 +181,7 @@ bool InputImpl::keyPressed(const OIS::KeyEvent &e)
 	InputKeyboardEvent keyEv;
 	keyEv.type = (input_keyboard_type) e.key;
 	keyEv.action = BUTTON_PRESSED;	
+	keyEv.captured = captureTime;
 	InformationManager::Instance()->postDataToFeed( "input_keyboard", DataContainer(keyEv) );
 	return true;
 }
@@ -168,6 +191,7 @@ bool InputImpl::keyReleased(const OIS::KeyEvent &e)
 	InputKeyboardEvent keyEv;
 	keyEv.type = (input_keyboard_type) e.key;
 	keyEv.action = BUTTON_RELEASED;
+	keyEv.captured = captureTime;
 	InformationManager::Instance()->postDataToFeed( "input_keyboard", DataContainer(keyEv) );
 	return true;
 }
@@ -0,0 +1,245 @@
+//
+// C++ Implementation: jobsystem
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "jobsystem.h"
+#include "profiler.h"
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+
+/** queue owned by the current thread, 0 (the shared queue) for threads which aren't workers **/
+static __thread int ownQueue = 0;
+
+JobSystem::JobSystem() : workerCount(std::max((int)boost::thread::hardware_concurrency() - 1, 1)), queued(0), nextVictim(0), stopping(false)
+{
+	// the workers name themselves in the Profiler right away, Singleton::Instance isn't safe to race on
+	Profiler::Instance();
+
+	for(int i = 0; i <= workerCount; i++)
+	{
+		queues.push_back(new WorkQueue);
+	}
+	for(int i = 0; i < workerCount; i++)
+	{
+		workers.push_back(new boost::thread(boost::bind(&JobSystem::workerLoop, this, i + 1)));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		boost::mutex::scoped_lock lock(sleepMutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for(size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i]->join();
+		delete workers[i];
+	}
+	for(size_t i = 0; i < queues.size(); i++)
+	{
+		delete queues[i];
+	}
+}
+
+void JobSystem::submit(const Job& job, JobCounter* counter)
+{
+	Entry entry;
+	entry.job = job;
+	entry.counter = counter;
+	if(counter)
+	{
+		counter->pending++;
+	}
+
+	{
+		WorkQueue& queue = *queues[ownQueue];
+		boost::mutex::scoped_lock lock(queue.mutex);
+		if(queue.jobs.full())
+		{
+			queue.jobs.set_capacity(queue.jobs.capacity() * 2);
+		}
+		queue.jobs.push_back(entry);
+	}
+	queued++;
+
+	// taking the lock makes sure a worker which just saw an empty system is already waiting
+	boost::mutex::scoped_lock lock(sleepMutex);
+	workAvailable.notify_one();
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	while(!counter.done())
+	{
+		// only jobs of this counter, any other one could need a lock the caller holds
+		if(!runOne(&counter))
+		{
+			// the remaining jobs are running on other threads
+			boost::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grain, const RangeJob& body)
+{
+	if(end <= begin)
+	{
+		return;
+	}
+
+	size_t count = end - begin;
+	// a few chunks per thread, so a worker which gets preempted doesn't hold up the others
+	size_t chunks = (workerCount + 1) * 4;
+	size_t chunkSize = std::max(std::max(grain, (size_t)1), (count + chunks - 1) / chunks);
+
+	if(chunkSize >= count)
+	{
+		body(begin, end);
+		return;
+	}
+
+	// binding body itself would copy it into every job, which doesn't fit into boost::function without allocating
+	Range range;
+	range.body = &body;
+	range.end = end;
+	range.chunkSize = chunkSize;
+
+	JobCounter counter;
+	for(size_t first = begin + chunkSize; first < end; first += chunkSize)
+	{
+		submit(boost::bind(&JobSystem::runChunk, &range, first), &counter);
+	}
+	body(begin, begin + chunkSize);
+	wait(counter);
+}
+
+void JobSystem::runChunk(const Range* range, size_t first)
+{
+	(*range->body)(first, std::min(first + range->chunkSize, range->end));
+}
+
+void JobSystem::workerLoop(int index)
+{
+	ownQueue = index;
+	Profiler::Instance().nameThread("job worker " + boost::lexical_cast<std::string>(index));
+
+	while(true)
+	{
+		if(runOne())
+		{
+			continue;
+		}
+
+		boost::mutex::scoped_lock lock(sleepMutex);
+		while(!stopping && queued == 0)
+		{
+			workAvailable.wait(lock);
+		}
+		if(stopping)
+		{
+			return;
+		}
+	}
+}
+
+bool JobSystem::runOne(const JobCounter* counter)
+{
+	Entry entry;
+	if(counter ? !popJobOf(counter, entry) : !pop(entry))
+	{
+		return false;
+	}
+
+	{
+		PROFILE_ZONE("job");
+		entry.job();
+	}
+	if(entry.counter)
+	{
+		entry.counter->pending--;
+	}
+	return true;
+}
+
+bool JobSystem::pop(Entry& entry)
+{
+	// newest own job first, its data is most likely still in the cache
+	if(ownQueue != 0 && popBack(*queues[ownQueue], entry))
+	{
+		return true;
+	}
+	if(popFront(*queues[0], entry))
+	{
+		return true;
+	}
+
+	// steal the oldest job of someone else, starting at a different victim each time
+	unsigned int start = nextVictim++;
+	for(int i = 0; i < workerCount; i++)
+	{
+		int victim = (start + i) % workerCount + 1;
+		if(victim != ownQueue && popFront(*queues[victim], entry))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::popJobOf(const JobCounter* counter, Entry& entry)
+{
+	// jobs are usually submitted by the thread waiting for them, so they are in its own queue
+	for(int i = 0; i <= workerCount; i++)
+	{
+		WorkQueue& queue = *queues[(ownQueue + i) % (workerCount + 1)];
+		boost::mutex::scoped_lock lock(queue.mutex);
+		for(boost::circular_buffer<Entry>::iterator it = queue.jobs.begin(); it != queue.jobs.end(); ++it)
+		{
+			if(it->counter == counter)
+			{
+				entry = *it;
+				queue.jobs.erase(it);
+				queued--;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool JobSystem::popBack(WorkQueue& queue, Entry& entry)
+{
+	boost::mutex::scoped_lock lock(queue.mutex);
+	if(queue.jobs.empty())
+	{
+		return false;
+	}
+	entry = queue.jobs.back();
+	queue.jobs.pop_back();
+	queued--;
+	return true;
+}
+
+bool JobSystem::popFront(WorkQueue& queue, Entry& entry)
+{
+	boost::mutex::scoped_lock lock(queue.mutex);
+	if(queue.jobs.empty())
+	{
+		return false;
+	}
+	entry = queue.jobs.front();
+	queue.jobs.pop_front();
+	queued--;
+	return true;
+}
@@ -0,0 +1,116 @@
+//
+// C++ Implementation: latencytracker
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "latencytracker.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+const double LatencyTracker::FIRST_BUCKET = 0.00005;
+const double LatencyTracker::BUCKET_GROWTH = 1.05;
+
+LatencyTracker::Stage::Stage(const char* name) : name(name), next(0), kept(0), total(0)
+{
+	std::memset(counts, 0, sizeof(counts));
+}
+
+size_t LatencyTracker::bucketFor(double seconds)
+{
+	if(seconds <= FIRST_BUCKET)
+	{
+		return 0;
+	}
+	double bucket = std::ceil(std::log(seconds / FIRST_BUCKET) / std::log(BUCKET_GROWTH));
+	return bucket < BUCKETS - 1 ? (size_t)bucket : BUCKETS - 1;
+}
+
+double LatencyTracker::bucketBound(size_t bucket)
+{
+	return FIRST_BUCKET * std::pow(BUCKET_GROWTH, (double)bucket);
+}
+
+double LatencyTracker::percentile(const Stage& stage, double fraction)
+{
+	// the same sample a sorted window would have at index kept * fraction, 1.0 is the maximum
+	size_t rank = std::min((size_t)(stage.kept * fraction), stage.kept - 1);
+	size_t seen = 0;
+	for(size_t i = 0; i < BUCKETS; i++)
+	{
+		seen += stage.counts[i];
+		if(seen > rank)
+		{
+			return bucketBound(i);
+		}
+	}
+	return bucketBound(BUCKETS - 1);
+}
+
+void LatencyTracker::addSample(const char* stage, double seconds)
+{
+	boost::mutex::scoped_lock lock(mutex);
+	std::vector<Stage>::iterator entry = stages.begin();
+	while(entry != stages.end() && entry->name != stage)
+	{
+		++entry;
+	}
+	if(entry == stages.end())
+	{
+		stages.push_back(Stage(stage));
+		entry = stages.end() - 1;
+	}
+
+	size_t bucket = bucketFor(seconds);
+	if(entry->kept < WINDOW)
+	{
+		entry->kept++;
+	}
+	else
+	{
+		entry->counts[entry->window[entry->next]]--;
+	}
+	entry->window[entry->next] = (unsigned char)bucket;
+	entry->counts[bucket]++;
+	entry->next = (entry->next + 1) % WINDOW;
+	entry->total++;
+	sampleCount++;
+}
+
+unsigned long LatencyTracker::getSampleCount()
+{
+	boost::mutex::scoped_lock lock(mutex);
+	return sampleCount;
+}
+
+void LatencyTracker::summary(std::string& text)
+{
+	boost::mutex::scoped_lock lock(mutex);
+	text.clear();
+
+	for(std::vector<Stage>::const_iterator it = stages.begin(); it != stages.end(); ++it)
+	{
+		char line[256];
+		std::snprintf(line, sizeof(line), "%s (%lu events) ms p50 / p95 / p99 / max: %.1f / %.1f / %.1f / %.1f\n",
+			it->name.c_str(), it->total,
+			percentile(*it, 0.5) * 1000.0,
+			percentile(*it, 0.95) * 1000.0,
+			percentile(*it, 0.99) * 1000.0,
+			percentile(*it, 1.0) * 1000.0);
+		text += line;
+	}
+}
+
+std::string LatencyTracker::summary()
+{
+	std::string text;
+	summary(text);
+	return text;
+}
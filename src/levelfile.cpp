@@ -0,0 +1,328 @@
+//
+// C++ Implementation: levelfile
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "levelfile.h"
+#include "FeedDataTypes.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char LEVEL_MAGIC[4] = { 'O', 'T', 'E', 'L' };
+
+const uint32_t LevelFile::VERSION;
+
+LevelFile::LevelFile() : data(0), size(0), header(0), offsets(0), strings(0), placements(0), spawns(0), collisions(0), resources(0), blobs(0)
+{
+}
+
+LevelFile::~LevelFile()
+{
+	close();
+}
+
+bool LevelFile::open(const std::string& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		return fail("can't open " + path);
+	}
+
+	struct stat info;
+	if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(LevelHeader))
+	{
+		::close(fd);
+		return fail(path + " is too small to be a level");
+	}
+
+	size = info.st_size;
+	data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid without the descriptor
+	::close(fd);
+	if(data == MAP_FAILED)
+	{
+		data = 0;
+		return fail("can't map " + path);
+	}
+
+	const char* bytes = (const char*)data;
+	header = (const LevelHeader*)bytes;
+
+	if(memcmp(header->magic, LEVEL_MAGIC, sizeof(LEVEL_MAGIC)) != 0)
+	{
+		return fail(path + " isn't a level file");
+	}
+	if(header->version != VERSION)
+	{
+		return fail(path + " has an unsupported version, recompile it with the serializer");
+	}
+
+	// only sizes and indices are checked, so a broken file can't make us read outside the mapping
+	size_t stringsStart = sizeof(LevelHeader) + header->stringCount * sizeof(uint32_t);
+	if(!fits(sizeof(LevelHeader), header->stringCount, sizeof(uint32_t)) || !fits(stringsStart, header->stringDataSize, 1)
+		|| !fits(header->placementOffset, header->placementCount, sizeof(LevelPlacement))
+		|| !fits(header->spawnOffset, header->spawnCount, sizeof(LevelPlacement))
+		|| !fits(header->collisionOffset, header->collisionCount, sizeof(LevelCollision))
+		|| !fits(header->resourceOffset, header->resourceCount, sizeof(uint32_t))
+		|| !fits(header->blobOffset, header->blobDataSize, 1))
+	{
+		return fail(path + " is truncated");
+	}
+
+	offsets = (const uint32_t*)(bytes + sizeof(LevelHeader));
+	strings = bytes + stringsStart;
+	placements = (const LevelPlacement*)(bytes + header->placementOffset);
+	spawns = (const LevelPlacement*)(bytes + header->spawnOffset);
+	collisions = (const LevelCollision*)(bytes + header->collisionOffset);
+	resources = (const uint32_t*)(bytes + header->resourceOffset);
+	blobs = bytes + header->blobOffset;
+
+	if(header->stringCount > 0 && (header->stringDataSize == 0 || strings[header->stringDataSize - 1] != 0))
+	{
+		return fail(path + " has an unterminated string table");
+	}
+	for(uint32_t i = 0; i < header->stringCount; i++)
+	{
+		if(offsets[i] >= header->stringDataSize)
+		{
+			return fail(path + " has a broken string table");
+		}
+	}
+	for(uint32_t i = 0; i < header->placementCount; i++)
+	{
+		if(placements[i].specification >= header->stringCount)
+		{
+			return fail(path + " refers to a string which isn't there");
+		}
+	}
+	for(uint32_t i = 0; i < header->spawnCount; i++)
+	{
+		if(spawns[i].specification >= header->stringCount)
+		{
+			return fail(path + " refers to a string which isn't there");
+		}
+	}
+	for(uint32_t i = 0; i < header->resourceCount; i++)
+	{
+		if(resources[i] >= header->stringCount)
+		{
+			return fail(path + " refers to a string which isn't there");
+		}
+	}
+	for(uint32_t i = 0; i < header->collisionCount; i++)
+	{
+		if(collisions[i].specification >= header->stringCount || (uint64_t)collisions[i].offset + collisions[i].size > header->blobDataSize)
+		{
+			return fail(path + " has a broken collision table");
+		}
+	}
+
+	return true;
+}
+
+void LevelFile::close()
+{
+	if(data)
+	{
+		munmap(data, size);
+	}
+	data = 0;
+	size = 0;
+	header = 0;
+	offsets = 0;
+	strings = 0;
+	placements = 0;
+	spawns = 0;
+	collisions = 0;
+	resources = 0;
+	blobs = 0;
+}
+
+bool LevelFile::fail(const std::string& why)
+{
+	close();
+	error = why;
+	return false;
+}
+
+bool LevelFile::fits(uint32_t offset, uint32_t count, size_t elementSize) const
+{
+	return offset % 4 == 0 && (uint64_t)offset + (uint64_t)count * elementSize <= size;
+}
+
+static void unpack(const LevelPlacement& placement, OgreNewt::Node& node, Ogre::Vector3& scale)
+{
+	node.pos = Ogre::Vector3(placement.pos[0], placement.pos[1], placement.pos[2]);
+	node.orient = Ogre::Quaternion(placement.orient[0], placement.orient[1], placement.orient[2], placement.orient[3]);
+	scale = Ogre::Vector3(placement.scale[0], placement.scale[1], placement.scale[2]);
+}
+
+void LevelFile::getTerrain(uint32_t i, Terrain& terrain) const
+{
+	unpack(placements[i], terrain.node, terrain.scale);
+	terrain.specification = getString(placements[i].specification);
+}
+
+void LevelFile::getObject(uint32_t i, ObjectToCreate& object) const
+{
+	unpack(spawns[i], object.node, object.scale);
+	object.specification = getString(spawns[i].specification);
+}
+
+bool LevelFile::findCollision(const std::string& specification, const Ogre::Vector3& scale, level_collision_type type, const void*& blob, size_t& blobSize) const
+{
+	// a level only has a handful of different meshes, a search is cheaper than building an index
+	for(uint32_t i = 0; i < header->collisionCount; i++)
+	{
+		const LevelCollision& collision = collisions[i];
+		if(collision.type == (uint32_t)type && scale == Ogre::Vector3(collision.scale[0], collision.scale[1], collision.scale[2])
+			&& specification == getString(collision.specification))
+		{
+			blob = blobs + collision.offset;
+			blobSize = collision.size;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+uint32_t LevelWriter::intern(const std::string& name)
+{
+	std::map<std::string, uint32_t>::iterator it = atoms.find(name);
+	if(it != atoms.end())
+	{
+		return it->second;
+	}
+
+	uint32_t atom = strings.size();
+	strings.push_back(name);
+	atoms[name] = atom;
+	return atom;
+}
+
+LevelPlacement LevelWriter::pack(const Terrain& terrain)
+{
+	LevelPlacement placement;
+	placement.pos[0] = terrain.node.pos.x;
+	placement.pos[1] = terrain.node.pos.y;
+	placement.pos[2] = terrain.node.pos.z;
+	placement.orient[0] = terrain.node.orient.w;
+	placement.orient[1] = terrain.node.orient.x;
+	placement.orient[2] = terrain.node.orient.y;
+	placement.orient[3] = terrain.node.orient.z;
+	placement.scale[0] = terrain.scale.x;
+	placement.scale[1] = terrain.scale.y;
+	placement.scale[2] = terrain.scale.z;
+
+	placement.specification = intern(terrain.specification);
+	if(std::find(resources.begin(), resources.end(), placement.specification) == resources.end())
+	{
+		resources.push_back(placement.specification);
+	}
+	return placement;
+}
+
+void LevelWriter::addPlacement(const Terrain& terrain)
+{
+	placements.push_back(pack(terrain));
+}
+
+void LevelWriter::addSpawn(const Terrain& object)
+{
+	spawns.push_back(pack(object));
+}
+
+void LevelWriter::addCollision(const std::string& specification, const Ogre::Vector3& scale, level_collision_type type, const std::vector<char>& blob)
+{
+	LevelCollision collision;
+	collision.specification = intern(specification);
+	collision.scale[0] = scale.x;
+	collision.scale[1] = scale.y;
+	collision.scale[2] = scale.z;
+	collision.type = type;
+	collision.offset = blobData.size();
+	collision.size = blob.size();
+	collisions.push_back(collision);
+
+	blobData.insert(blobData.end(), blob.begin(), blob.end());
+}
+
+/** orders spawns by the name of their mesh, not by atom, so the order doesn't depend on the input order **/
+class SpecificationOrder
+{
+	public:
+		SpecificationOrder(const std::vector<std::string>& strings) : strings(strings) { }
+
+		bool operator()(const LevelPlacement& a, const LevelPlacement& b) const
+		{
+			return strings[a.specification] < strings[b.specification];
+		}
+
+	private:
+		const std::vector<std::string>& strings;
+};
+
+template<typename T> static void writeArray(std::ofstream& file, const std::vector<T>& array)
+{
+	if(!array.empty())
+	{
+		file.write((const char*)&array[0], array.size() * sizeof(T));
+	}
+}
+
+bool LevelWriter::write(const std::string& path)
+{
+	std::stable_sort(spawns.begin(), spawns.end(), SpecificationOrder(strings));
+
+	std::vector<uint32_t> offsets;
+	std::vector<char> stringData;
+	for(std::vector<std::string>::const_iterator it = strings.begin(); it != strings.end(); ++it)
+	{
+		offsets.push_back(stringData.size());
+		stringData.insert(stringData.end(), it->c_str(), it->c_str() + it->size() + 1);
+	}
+	// keeps everything after the strings 4 byte aligned
+	stringData.resize((stringData.size() + 3) / 4 * 4, '\0');
+
+	LevelHeader header;
+	memcpy(header.magic, LEVEL_MAGIC, sizeof(LEVEL_MAGIC));
+	header.version = LevelFile::VERSION;
+	header.stringCount = strings.size();
+	header.stringDataSize = stringData.size();
+	header.placementCount = placements.size();
+	header.placementOffset = sizeof(LevelHeader) + offsets.size() * sizeof(uint32_t) + stringData.size();
+	header.spawnCount = spawns.size();
+	header.spawnOffset = header.placementOffset + placements.size() * sizeof(LevelPlacement);
+	header.collisionCount = collisions.size();
+	header.collisionOffset = header.spawnOffset + spawns.size() * sizeof(LevelPlacement);
+	header.resourceCount = resources.size();
+	header.resourceOffset = header.collisionOffset + collisions.size() * sizeof(LevelCollision);
+	header.blobDataSize = blobData.size();
+	header.blobOffset = header.resourceOffset + resources.size() * sizeof(uint32_t);
+
+	std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	writeArray(file, offsets);
+	writeArray(file, stringData);
+	writeArray(file, placements);
+	writeArray(file, spawns);
+	writeArray(file, collisions);
+	writeArray(file, resources);
+	writeArray(file, blobData);
+	return file.good();
+}
@@ -5,16 +5,59 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string>
 
 #include <taskengine/taskengine.h>
 #include "physics.h"
 #include "graphics.h"
 #include "game.h"
 #include "input.h"
+#include "startupprofiler.h"
+#include "settingsmanager.h"
+#include "jobsystem.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "latencytracker.h"
+#include "objectregistry.h"
+#include "resourcemanager.h"
 
 int main(int argc, char *argv[])
 {
 	initDebug();
+	// startup phases are timed relative to this
+	StartupProfiler::Instance();
+	// created before any task thread can record a zone
+	Profiler::Instance().nameThread("main");
+	// Singleton::Instance() isn't synchronised, everything the task threads share is created here before they start
+	Metrics::Instance();
+	LatencyTracker::Instance();
+	ObjectRegistry::Instance();
+	ResourceManager::Instance();
+	JobSystem::Instance();
+
+	// --headless [seconds]: render offscreen without input, log frame timings and quit after seconds (default 30)
+	int headless = 0;
+	int headlessDuration = 30;
+	// --assert-no-allocations: physics and graphics frames must not allocate once the scene has settled
+	int assertNoAllocations = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--headless")
+		{
+			headless = 1;
+			if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+			{
+				headlessDuration = atoi(argv[++i]);
+			}
+		}
+		else if (std::string(argv[i]) == "--assert-no-allocations")
+		{
+			assertNoAllocations = 1;
+		}
+	}
+	SettingsManager::Instance().addSetting("headless", DataContainer(headless));
+	SettingsManager::Instance().addSetting("headless_duration", DataContainer(headlessDuration));
+	SettingsManager::Instance().addSetting("assert_no_allocations", DataContainer(assertNoAllocations));
 
 	Threadmanager myManager;
 	Graphics graphics;;
@@ -22,14 +65,22 @@ int main(int argc, char *argv[])
 	Input input;
 	Game game;
 
-#ifdef SINGLE_THREADED
+#if defined(SINGLE_THREADED) || defined(JOB_SYSTEM)
 	myManager.setThreadingMode(THREADING_SEQUENCIAL);
 #endif
+#ifdef JOB_SYSTEM
+	// the tasks share one thread, everything heavy is handed to the workers as jobs
+	Dout << "Running tasks sequentially, " << JobSystem::Instance().getWorkerCount() << " job workers";
+#endif
 
 	myManager.registerTask(&game);
 	myManager.registerTask(&graphics);
 	myManager.registerTask(&physics);
-	myManager.registerTask(&input);
+	// without a window there is nothing to read input from
+	if (!headless)
+	{
+		myManager.registerTask(&input);
+	}
 
 	myManager.run();
 
@@ -0,0 +1,196 @@
+//
+// C++ Implementation: metrics
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "metrics.h"
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+Histogram::Histogram(const std::vector<double>& bounds) : bounds(bounds), buckets(bounds.size() + 1), count(0), sum(0.0)
+{
+	for(size_t i = 0; i < buckets.size(); i++)
+	{
+		buckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void Histogram::observe(double value)
+{
+	// a handful of buckets, a linear search is as fast as a binary one
+	size_t i = 0;
+	while(i < bounds.size() && value > bounds[i])
+	{
+		i++;
+	}
+	buckets[i].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+
+	double old = sum.load(std::memory_order_relaxed);
+	while(!sum.compare_exchange_weak(old, old + value, std::memory_order_relaxed))
+	{
+	}
+}
+
+double Histogram::getQuantile(double q) const
+{
+	uint64_t total = getCount();
+	uint64_t seen = 0;
+	for(size_t i = 0; i < bounds.size(); i++)
+	{
+		seen += getBucket(i);
+		if(total > 0 && seen >= q * total)
+		{
+			return bounds[i];
+		}
+	}
+	return std::numeric_limits<double>::infinity();
+}
+
+std::vector<double> Histogram::exponentialBounds(double first, double factor, int count)
+{
+	std::vector<double> bounds;
+	for(int i = 0; i < count; i++, first *= factor)
+	{
+		bounds.push_back(first);
+	}
+	return bounds;
+}
+
+Metrics::~Metrics()
+{
+	for(std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		delete it->second.counter;
+		delete it->second.gauge;
+		delete it->second.histogram;
+	}
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& help)
+{
+	boost::mutex::scoped_lock lock(mutex);
+	Entry& entry = entries[name];
+	if(!entry.counter)
+	{
+		entry.help = help;
+		entry.counter = new Counter;
+	}
+	return *entry.counter;
+}
+
+Gauge& Metrics::gauge(const std::string& name, const std::string& help)
+{
+	boost::mutex::scoped_lock lock(mutex);
+	Entry& entry = entries[name];
+	if(!entry.gauge)
+	{
+		entry.help = help;
+		entry.gauge = new Gauge;
+	}
+	return *entry.gauge;
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds)
+{
+	boost::mutex::scoped_lock lock(mutex);
+	Entry& entry = entries[name];
+	if(!entry.histogram)
+	{
+		entry.help = help;
+		entry.histogram = new Histogram(bounds);
+	}
+	return *entry.histogram;
+}
+
+std::string Metrics::exposition()
+{
+	boost::mutex::scoped_lock lock(mutex);
+	std::ostringstream text;
+	text.precision(10);
+
+	for(std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		const std::string& name = it->first;
+		const Entry& entry = it->second;
+		text << "# HELP " << name << " " << entry.help << "\n";
+
+		if(entry.counter)
+		{
+			text << "# TYPE " << name << " counter\n" << name << " " << entry.counter->get() << "\n";
+		}
+		else if(entry.gauge)
+		{
+			text << "# TYPE " << name << " gauge\n" << name << " " << entry.gauge->get() << "\n";
+		}
+		else if(entry.histogram)
+		{
+			const Histogram& histogram = *entry.histogram;
+			text << "# TYPE " << name << " histogram\n";
+
+			// buckets are cumulative in the exposition format
+			uint64_t cumulative = 0;
+			for(size_t i = 0; i < histogram.getBounds().size(); i++)
+			{
+				cumulative += histogram.getBucket(i);
+				text << name << "_bucket{le=\"" << histogram.getBounds()[i] << "\"} " << cumulative << "\n";
+			}
+			cumulative += histogram.getBucket(histogram.getBounds().size());
+			text << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+			text << name << "_sum " << histogram.getSum() << "\n";
+			text << name << "_count " << histogram.getCount() << "\n";
+		}
+	}
+	return text.str();
+}
+
+std::string Metrics::summary()
+{
+	boost::mutex::scoped_lock lock(mutex);
+	std::ostringstream text;
+	text.precision(6);
+
+	for(std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		const Entry& entry = it->second;
+		text << it->first << ": ";
+
+		if(entry.counter)
+		{
+			text << entry.counter->get();
+		}
+		else if(entry.gauge)
+		{
+			text << entry.gauge->get();
+		}
+		else if(entry.histogram && entry.histogram->getCount() > 0)
+		{
+			const Histogram& histogram = *entry.histogram;
+			text << "mean " << histogram.getSum() / histogram.getCount() << ", p95 <= " << histogram.getQuantile(0.95);
+		}
+		text << "\n";
+	}
+	return text.str();
+}
+
+bool Metrics::writeFile(const std::string& path)
+{
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary.c_str(), std::ios::trunc);
+		file << exposition();
+		if(!file.good())
+		{
+			return false;
+		}
+	}
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
@@ -11,17 +11,51 @@
 //
 #include "objectregistry.h"
 
-ObjectRegistry::ObjectRegistry() : objectIDCounter(0)
+ObjectRegistry::ObjectRegistry()
 {
+	// atom 0 is the empty string, the name of unknown IDs
+	objects.push_back(internLocked(""));
 }
 
 int ObjectRegistry::addObject(const std::string& name)
 {
-	objects[++objectIDCounter] = name;
-	return objectIDCounter;
+	boost::mutex::scoped_lock lock(mutex);
+	objects.push_back(internLocked(name));
+	return objects.size() - 1;
 }
 
 const std::string& ObjectRegistry::getNameForID(int id)
 {
-	return objects[id];
-}
\ No newline at end of file
+	boost::mutex::scoped_lock lock(mutex);
+	if(id < 0 || id >= (int)objects.size())
+	{
+		return strings.front();
+	}
+	return strings[objects[id]];
+}
+
+uint32_t ObjectRegistry::intern(const std::string& name)
+{
+	boost::mutex::scoped_lock lock(mutex);
+	return internLocked(name);
+}
+
+const std::string& ObjectRegistry::getString(uint32_t atom)
+{
+	boost::mutex::scoped_lock lock(mutex);
+	return strings[atom];
+}
+
+uint32_t ObjectRegistry::internLocked(const std::string& name)
+{
+	std::map<std::string, uint32_t>::iterator it = atoms.find(name);
+	if(it != atoms.end())
+	{
+		return it->second;
+	}
+
+	uint32_t atom = strings.size();
+	strings.push_back(name);
+	atoms[name] = atom;
+	return atom;
+}
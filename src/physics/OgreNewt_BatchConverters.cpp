@@ -0,0 +1,359 @@
+#include "OgreNewt_stdafx.h"
+#include "OgreNewt_BatchConverters.h"
+#include "OgreNewt_Tools.h"
+
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__) && (OGRE_DOUBLE_PRECISION == 0)
+#   define OGRENEWT_BATCH_SIMD
+#   include <immintrin.h>
+#endif
+
+namespace OgreNewt
+{
+
+    namespace Converters
+    {
+
+        // ---------------------------------------------------------------------------------------------
+        // scalar versions, these are the reference for the SIMD code below
+        // ---------------------------------------------------------------------------------------------
+        static void QuatPosToMatrixScalar( const Ogre::Quaternion* quats, const Ogre::Vector3* positions, float* matrices, size_t count )
+        {
+            for (size_t i = 0; i < count; i++)
+                QuatPosToMatrix( quats[i], positions[i], &matrices[i*16] );
+        }
+
+        static void MatrixToQuatPosScalar( const float* matrices, Ogre::Quaternion* quats, Ogre::Vector3* positions, size_t count )
+        {
+            for (size_t i = 0; i < count; i++)
+                MatrixToQuatPos( &matrices[i*16], quats[i], positions[i] );
+        }
+
+        static void Matrix4ToMatrixScalar( const Ogre::Matrix4* matrices_in, float* matrices_out, size_t count )
+        {
+            for (size_t i = 0; i < count; i++)
+                Matrix4ToMatrix( matrices_in[i], &matrices_out[i*16] );
+        }
+
+
+#ifdef OGRENEWT_BATCH_SIMD
+
+        // ---------------------------------------------------------------------------------------------
+        // SSE2 versions, 4 elements per iteration.
+        // Data is transposed into one register per component (x of 4 quaternions, y of 4, ...),
+        // the math is the same as in Ogre::Quaternion::ToRotationMatrix, and transposed back for storing.
+        // ---------------------------------------------------------------------------------------------
+        __attribute__((target("sse2")))
+        static inline void storeMatrixRows4( float* out, __m128 a, __m128 b, __m128 c, __m128 d )
+        {
+            // a, b, c, d hold 4 consecutive entries of the Newton matrix for 4 different bodies
+            _MM_TRANSPOSE4_PS( a, b, c, d );
+            _mm_storeu_ps( out, a );
+            _mm_storeu_ps( out + 16, b );
+            _mm_storeu_ps( out + 32, c );
+            _mm_storeu_ps( out + 48, d );
+        }
+
+        __attribute__((target("sse2")))
+        static void QuatPosToMatrixSSE2( const Ogre::Quaternion* quats, const Ogre::Vector3* positions, float* matrices, size_t count )
+        {
+            const __m128 one = _mm_set1_ps( 1.0f );
+            const __m128 zero = _mm_setzero_ps();
+            size_t i = 0;
+
+            for (; i + 4 <= count; i += 4)
+            {
+                // Ogre::Quaternion is laid out w, x, y, z
+                __m128 w = _mm_loadu_ps( &quats[i].w );
+                __m128 x = _mm_loadu_ps( &quats[i+1].w );
+                __m128 y = _mm_loadu_ps( &quats[i+2].w );
+                __m128 z = _mm_loadu_ps( &quats[i+3].w );
+                _MM_TRANSPOSE4_PS( w, x, y, z );
+
+                // normalise, like QuatPosToMatrix does
+                __m128 len = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( w, w ), _mm_mul_ps( x, x ) ),
+                                                      _mm_add_ps( _mm_mul_ps( y, y ), _mm_mul_ps( z, z ) ) ) );
+                __m128 inv = _mm_div_ps( one, len );
+                w = _mm_mul_ps( w, inv );
+                x = _mm_mul_ps( x, inv );
+                y = _mm_mul_ps( y, inv );
+                z = _mm_mul_ps( z, inv );
+
+                __m128 tx = _mm_add_ps( x, x );
+                __m128 ty = _mm_add_ps( y, y );
+                __m128 tz = _mm_add_ps( z, z );
+                __m128 twx = _mm_mul_ps( tx, w );
+                __m128 twy = _mm_mul_ps( ty, w );
+                __m128 twz = _mm_mul_ps( tz, w );
+                __m128 txx = _mm_mul_ps( tx, x );
+                __m128 txy = _mm_mul_ps( ty, x );
+                __m128 txz = _mm_mul_ps( tz, x );
+                __m128 tyy = _mm_mul_ps( ty, y );
+                __m128 tyz = _mm_mul_ps( tz, y );
+                __m128 tzz = _mm_mul_ps( tz, z );
+
+                // first column of the rotation matrix
+                __m128 m00 = _mm_sub_ps( one, _mm_add_ps( tyy, tzz ) );
+                __m128 m10 = _mm_add_ps( txy, twz );
+                __m128 m20 = _mm_sub_ps( txz, twy );
+                // second column
+                __m128 m01 = _mm_sub_ps( txy, twz );
+                __m128 m11 = _mm_sub_ps( one, _mm_add_ps( txx, tzz ) );
+                __m128 m21 = _mm_add_ps( tyz, twx );
+                // third column
+                __m128 m02 = _mm_add_ps( txz, twy );
+                __m128 m12 = _mm_sub_ps( tyz, twx );
+                __m128 m22 = _mm_sub_ps( one, _mm_add_ps( txx, tyy ) );
+
+                float* out = &matrices[i*16];
+                storeMatrixRows4( out, m00, m10, m20, zero );
+                storeMatrixRows4( out + 4, m01, m11, m21, zero );
+                storeMatrixRows4( out + 8, m02, m12, m22, zero );
+                for (int j = 0; j < 4; j++)
+                    _mm_storeu_ps( out + j*16 + 12, _mm_set_ps( 1.0f, positions[i+j].z, positions[i+j].y, positions[i+j].x ) );
+            }
+
+            QuatPosToMatrixScalar( quats + i, positions + i, matrices + i*16, count - i );
+        }
+
+        __attribute__((target("sse2")))
+        static inline __m128 select( __m128 mask, __m128 a, __m128 b )
+        {
+            return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+        }
+
+        __attribute__((target("sse2")))
+        static void MatrixToQuatPosSSE2( const float* matrices, Ogre::Quaternion* quats, Ogre::Vector3* positions, size_t count )
+        {
+            const __m128 one = _mm_set1_ps( 1.0f );
+            const __m128 half = _mm_set1_ps( 0.5f );
+            const __m128 zero = _mm_setzero_ps();
+            size_t i = 0;
+
+            for (; i + 4 <= count; i += 4)
+            {
+                const float* in = &matrices[i*16];
+
+                // rotation part; Newton stores the columns of the rotation, so R(r,c) = matrix[c*4 + r]
+                __m128 m00 = _mm_loadu_ps( in ), m10 = _mm_loadu_ps( in + 16 ), m20 = _mm_loadu_ps( in + 32 ), c0w = _mm_loadu_ps( in + 48 );
+                _MM_TRANSPOSE4_PS( m00, m10, m20, c0w );
+                __m128 m01 = _mm_loadu_ps( in + 4 ), m11 = _mm_loadu_ps( in + 20 ), m21 = _mm_loadu_ps( in + 36 ), c1w = _mm_loadu_ps( in + 52 );
+                _MM_TRANSPOSE4_PS( m01, m11, m21, c1w );
+                __m128 m02 = _mm_loadu_ps( in + 8 ), m12 = _mm_loadu_ps( in + 24 ), m22 = _mm_loadu_ps( in + 40 ), c2w = _mm_loadu_ps( in + 56 );
+                _MM_TRANSPOSE4_PS( m02, m12, m22, c2w );
+
+                // branch free version of Shoemake's conversion: the magnitudes come from the diagonal, only the largest is used
+                __m128 w = _mm_mul_ps( half, _mm_sqrt_ps( _mm_max_ps( zero, _mm_add_ps( one, _mm_add_ps( m00, _mm_add_ps( m11, m22 ) ) ) ) ) );
+                __m128 x = _mm_mul_ps( half, _mm_sqrt_ps( _mm_max_ps( zero, _mm_add_ps( one, _mm_sub_ps( m00, _mm_add_ps( m11, m22 ) ) ) ) ) );
+                __m128 y = _mm_mul_ps( half, _mm_sqrt_ps( _mm_max_ps( zero, _mm_add_ps( one, _mm_sub_ps( m11, _mm_add_ps( m00, m22 ) ) ) ) ) );
+                __m128 z = _mm_mul_ps( half, _mm_sqrt_ps( _mm_max_ps( zero, _mm_add_ps( one, _mm_sub_ps( m22, _mm_add_ps( m00, m11 ) ) ) ) ) );
+
+                // The off-diagonals hold the products of two components (m21 - m12 = 4wx, m01 + m10 = 4xy, ...).
+                // The largest component is at least 0.5 and taken as positive, the others are its products divided
+                // by it, which gives their sign and is exact for small ones. Products with a component near 0
+                // (w of a 180 degree rotation) can't be used, they carry no sign.
+                __m128 wx = _mm_sub_ps( m21, m12 ), wy = _mm_sub_ps( m02, m20 ), wz = _mm_sub_ps( m10, m01 );
+                __m128 xy = _mm_add_ps( m01, m10 ), xz = _mm_add_ps( m02, m20 ), yz = _mm_add_ps( m12, m21 );
+                __m128 wLargest = _mm_and_ps( _mm_cmpge_ps( w, x ), _mm_and_ps( _mm_cmpge_ps( w, y ), _mm_cmpge_ps( w, z ) ) );
+                __m128 xLargest = _mm_andnot_ps( wLargest, _mm_and_ps( _mm_cmpge_ps( x, y ), _mm_cmpge_ps( x, z ) ) );
+                __m128 yLargest = _mm_andnot_ps( _mm_or_ps( wLargest, xLargest ), _mm_cmpge_ps( y, z ) );
+                __m128 zLargest = _mm_andnot_ps( _mm_or_ps( wLargest, _mm_or_ps( xLargest, yLargest ) ), _mm_cmpeq_ps( zero, zero ) );
+
+                __m128 largest = select( wLargest, w, select( xLargest, x, select( yLargest, y, z ) ) );
+                __m128 inv = _mm_div_ps( _mm_set1_ps( 0.25f ), largest );
+
+                w = select( wLargest, w, _mm_mul_ps( inv, select( xLargest, wx, select( yLargest, wy, wz ) ) ) );
+                x = select( xLargest, x, _mm_mul_ps( inv, select( wLargest, wx, select( yLargest, xy, xz ) ) ) );
+                y = select( yLargest, y, _mm_mul_ps( inv, select( wLargest, wy, select( xLargest, xy, yz ) ) ) );
+                z = select( zLargest, z, _mm_mul_ps( inv, select( wLargest, wz, select( xLargest, xz, yz ) ) ) );
+
+                // q and -q are the same rotation, return the one with w >= 0
+                __m128 flip = _mm_and_ps( _mm_cmplt_ps( w, zero ), _mm_set1_ps( -0.0f ) );
+                w = _mm_xor_ps( w, flip );
+                x = _mm_xor_ps( x, flip );
+                y = _mm_xor_ps( y, flip );
+                z = _mm_xor_ps( z, flip );
+
+                _MM_TRANSPOSE4_PS( w, x, y, z );
+                _mm_storeu_ps( &quats[i].w, w );
+                _mm_storeu_ps( &quats[i+1].w, x );
+                _mm_storeu_ps( &quats[i+2].w, y );
+                _mm_storeu_ps( &quats[i+3].w, z );
+
+                for (int j = 0; j < 4; j++)
+                    positions[i+j] = Ogre::Vector3( in[j*16 + 12], in[j*16 + 13], in[j*16 + 14] );
+            }
+
+            MatrixToQuatPosScalar( matrices + i*16, quats + i, positions + i, count - i );
+        }
+
+        __attribute__((target("sse2")))
+        static void Matrix4ToMatrixSSE2( const Ogre::Matrix4* matrices_in, float* matrices_out, size_t count )
+        {
+            // a Newton matrix is the transposed Ogre::Matrix4
+            for (size_t i = 0; i < count; i++)
+            {
+                const Ogre::Matrix4& m = matrices_in[i];
+                __m128 r0 = _mm_loadu_ps( m[0] ), r1 = _mm_loadu_ps( m[1] ), r2 = _mm_loadu_ps( m[2] ), r3 = _mm_loadu_ps( m[3] );
+                _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+                float* out = &matrices_out[i*16];
+                _mm_storeu_ps( out, r0 );
+                _mm_storeu_ps( out + 4, r1 );
+                _mm_storeu_ps( out + 8, r2 );
+                _mm_storeu_ps( out + 12, r3 );
+            }
+        }
+
+
+        // ---------------------------------------------------------------------------------------------
+        // AVX version of QuatPosToMatrix, 8 elements per iteration.
+        // The math runs on 8 lanes, loading and storing is done as two SSE halves.
+        // ---------------------------------------------------------------------------------------------
+        __attribute__((target("avx")))
+        static inline __m256 combine( __m128 low, __m128 high )
+        {
+            return _mm256_insertf128_ps( _mm256_castps128_ps256( low ), high, 1 );
+        }
+
+        __attribute__((target("avx")))
+        static inline void storeMatrixRows8( float* out, __m256 a, __m256 b, __m256 c, __m256 d )
+        {
+            __m128 al = _mm256_castps256_ps128( a ), bl = _mm256_castps256_ps128( b ), cl = _mm256_castps256_ps128( c ), dl = _mm256_castps256_ps128( d );
+            __m128 ah = _mm256_extractf128_ps( a, 1 ), bh = _mm256_extractf128_ps( b, 1 ), ch = _mm256_extractf128_ps( c, 1 ), dh = _mm256_extractf128_ps( d, 1 );
+            _MM_TRANSPOSE4_PS( al, bl, cl, dl );
+            _MM_TRANSPOSE4_PS( ah, bh, ch, dh );
+            _mm_storeu_ps( out, al );
+            _mm_storeu_ps( out + 16, bl );
+            _mm_storeu_ps( out + 32, cl );
+            _mm_storeu_ps( out + 48, dl );
+            _mm_storeu_ps( out + 64, ah );
+            _mm_storeu_ps( out + 80, bh );
+            _mm_storeu_ps( out + 96, ch );
+            _mm_storeu_ps( out + 112, dh );
+        }
+
+        __attribute__((target("avx")))
+        static void QuatPosToMatrixAVX( const Ogre::Quaternion* quats, const Ogre::Vector3* positions, float* matrices, size_t count )
+        {
+            const __m256 one = _mm256_set1_ps( 1.0f );
+            const __m256 zero = _mm256_setzero_ps();
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128 w0 = _mm_loadu_ps( &quats[i].w ), x0 = _mm_loadu_ps( &quats[i+1].w ), y0 = _mm_loadu_ps( &quats[i+2].w ), z0 = _mm_loadu_ps( &quats[i+3].w );
+                __m128 w1 = _mm_loadu_ps( &quats[i+4].w ), x1 = _mm_loadu_ps( &quats[i+5].w ), y1 = _mm_loadu_ps( &quats[i+6].w ), z1 = _mm_loadu_ps( &quats[i+7].w );
+                _MM_TRANSPOSE4_PS( w0, x0, y0, z0 );
+                _MM_TRANSPOSE4_PS( w1, x1, y1, z1 );
+                __m256 w = combine( w0, w1 ), x = combine( x0, x1 ), y = combine( y0, y1 ), z = combine( z0, z1 );
+
+                __m256 len = _mm256_sqrt_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( w, w ), _mm256_mul_ps( x, x ) ),
+                                                            _mm256_add_ps( _mm256_mul_ps( y, y ), _mm256_mul_ps( z, z ) ) ) );
+                __m256 inv = _mm256_div_ps( one, len );
+                w = _mm256_mul_ps( w, inv );
+                x = _mm256_mul_ps( x, inv );
+                y = _mm256_mul_ps( y, inv );
+                z = _mm256_mul_ps( z, inv );
+
+                __m256 tx = _mm256_add_ps( x, x );
+                __m256 ty = _mm256_add_ps( y, y );
+                __m256 tz = _mm256_add_ps( z, z );
+                __m256 twx = _mm256_mul_ps( tx, w );
+                __m256 twy = _mm256_mul_ps( ty, w );
+                __m256 twz = _mm256_mul_ps( tz, w );
+                __m256 txx = _mm256_mul_ps( tx, x );
+                __m256 txy = _mm256_mul_ps( ty, x );
+                __m256 txz = _mm256_mul_ps( tz, x );
+                __m256 tyy = _mm256_mul_ps( ty, y );
+                __m256 tyz = _mm256_mul_ps( tz, y );
+                __m256 tzz = _mm256_mul_ps( tz, z );
+
+                float* out = &matrices[i*16];
+                storeMatrixRows8( out, _mm256_sub_ps( one, _mm256_add_ps( tyy, tzz ) ), _mm256_add_ps( txy, twz ), _mm256_sub_ps( txz, twy ), zero );
+                storeMatrixRows8( out + 4, _mm256_sub_ps( txy, twz ), _mm256_sub_ps( one, _mm256_add_ps( txx, tzz ) ), _mm256_add_ps( tyz, twx ), zero );
+                storeMatrixRows8( out + 8, _mm256_add_ps( txz, twy ), _mm256_sub_ps( tyz, twx ), _mm256_sub_ps( one, _mm256_add_ps( txx, tyy ) ), zero );
+                for (int j = 0; j < 8; j++)
+                    _mm_storeu_ps( out + j*16 + 12, _mm_set_ps( 1.0f, positions[i+j].z, positions[i+j].y, positions[i+j].x ) );
+            }
+
+            QuatPosToMatrixSSE2( quats + i, positions + i, matrices + i*16, count - i );
+        }
+
+#endif  // OGRENEWT_BATCH_SIMD
+
+
+        // ---------------------------------------------------------------------------------------------
+        // runtime dispatch
+        // ---------------------------------------------------------------------------------------------
+        typedef void (*QuatPosToMatrixFunc)( const Ogre::Quaternion*, const Ogre::Vector3*, float*, size_t );
+        typedef void (*MatrixToQuatPosFunc)( const float*, Ogre::Quaternion*, Ogre::Vector3*, size_t );
+        typedef void (*Matrix4ToMatrixFunc)( const Ogre::Matrix4*, float*, size_t );
+
+        struct BatchConverterTable
+        {
+            QuatPosToMatrixFunc quatPosToMatrix;
+            MatrixToQuatPosFunc matrixToQuatPos;
+            Matrix4ToMatrixFunc matrix4ToMatrix;
+            const char* name;
+        };
+
+        static BatchConverterTable scalarTable()
+        {
+            BatchConverterTable table = { QuatPosToMatrixScalar, MatrixToQuatPosScalar, Matrix4ToMatrixScalar, "scalar" };
+            return table;
+        }
+
+        static BatchConverterTable detectTable()
+        {
+            BatchConverterTable table = scalarTable();
+#ifdef OGRENEWT_BATCH_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports( "sse2" ))
+            {
+                table.quatPosToMatrix = QuatPosToMatrixSSE2;
+                table.matrixToQuatPos = MatrixToQuatPosSSE2;
+                table.matrix4ToMatrix = Matrix4ToMatrixSSE2;
+                table.name = "sse2";
+            }
+            if (__builtin_cpu_supports( "avx" ))
+            {
+                table.quatPosToMatrix = QuatPosToMatrixAVX;
+                table.name = "avx";
+            }
+#endif
+            return table;
+        }
+
+        static BatchConverterTable& activeTable()
+        {
+            static BatchConverterTable table = detectTable();
+            return table;
+        }
+
+        void QuatPosToMatrixBatch( const Ogre::Quaternion* quats, const Ogre::Vector3* positions, float* matrices, size_t count )
+        {
+            activeTable().quatPosToMatrix( quats, positions, matrices, count );
+        }
+
+        void MatrixToQuatPosBatch( const float* matrices, Ogre::Quaternion* quats, Ogre::Vector3* positions, size_t count )
+        {
+            activeTable().matrixToQuatPos( matrices, quats, positions, count );
+        }
+
+        void Matrix4ToMatrixBatch( const Ogre::Matrix4* matrices_in, float* matrices_out, size_t count )
+        {
+            activeTable().matrix4ToMatrix( matrices_in, matrices_out, count );
+        }
+
+        const char* getBatchConverterPath()
+        {
+            return activeTable().name;
+        }
+
+        void setBatchConverterScalar( bool scalar )
+        {
+            activeTable() = scalar ? scalarTable() : detectTable();
+        }
+
+    }   // end namespace Converters
+
+}   // end namespace OgreNewt
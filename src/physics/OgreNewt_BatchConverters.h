@@ -0,0 +1,52 @@
+/*
+    OgreNewt Library
+
+    Ogre implementation of Newton Game Dynamics SDK
+
+    OgreNewt basically has no license, you may use any or all of the library however you desire... I hope it can help you in any way.
+
+        by Walaber
+        some changes by melven
+
+*/
+#ifndef _INCLUDE_OGRENEWT_BATCHCONVERTERS
+#define _INCLUDE_OGRENEWT_BATCHCONVERTERS
+
+#include "OgreNewt_Prerequisites.h"
+
+// OgreNewt namespace.  all functions and classes use this namespace.
+namespace OgreNewt
+{
+
+    namespace Converters
+    {
+        //! Array versions of the converters in OgreNewt_Tools.h
+        /*!
+            These do the same as calling QuatPosToMatrix, MatrixToQuatPos and Matrix4ToMatrix once per element,
+            but handle 4 (SSE) or 8 (AVX) elements at once. The instruction set is chosen at runtime from what
+            the CPU supports, with the scalar routines as fallback (also used when Ogre::Real is a double).
+            Newton matrices are packed, 16 floats per matrix.
+        */
+        _OgreNewtExport void QuatPosToMatrixBatch( const Ogre::Quaternion* quats, const Ogre::Vector3* positions, float* matrices, size_t count );
+
+        //! Newton matrices to Quaternion + Position_vector, see QuatPosToMatrixBatch.
+        /*!
+            The SIMD versions return quaternions with w >= 0, the scalar version may return the negated
+            quaternion instead, which is the same rotation.
+        */
+        _OgreNewtExport void MatrixToQuatPosBatch( const float* matrices, Ogre::Quaternion* quats, Ogre::Vector3* positions, size_t count );
+
+        //! Ogre::Matrix4 array to Newton matrices, see QuatPosToMatrixBatch.
+        _OgreNewtExport void Matrix4ToMatrixBatch( const Ogre::Matrix4* matrices_in, float* matrices_out, size_t count );
+
+        //! name of the code path used by the batch converters ("avx", "sse2" or "scalar")
+        _OgreNewtExport const char* getBatchConverterPath();
+
+        //! force the scalar code path, mainly for benchmarking / validating the SIMD versions
+        _OgreNewtExport void setBatchConverterScalar( bool scalar );
+
+    }   // end namespace Converters
+
+}   // end namespace OgreNewt
+
+#endif
@@ -0,0 +1,175 @@
+#include "OgreNewt_stdafx.h"
+#include "OgreNewt_DebugLineBatch.h"
+#include "OgreNewt_Collision.h"
+#include "OgreNewt_World.h"
+#include "OgreNewt_Tools.h"
+
+#ifdef __APPLE__
+#   include <Ogre/OgreSceneNode.h>
+#   include <Ogre/OgreManualObject.h>
+#else
+#   include <OgreSceneNode.h>
+#   include <OgreManualObject.h>
+#endif
+
+namespace OgreNewt
+{
+
+DebugLineBatch::DebugLineBatch( Ogre::SceneNode* node, const Ogre::String& name )
+{
+    m_node = node;
+    m_built = false;
+
+    m_lines = new Ogre::ManualObject( name );
+    // the buffer is rewritten every frame, let Ogre keep it in dynamic memory and reuse it as long as it fits
+    m_lines->setDynamic( true );
+    m_lines->setCastShadows( false );
+    m_node->attachObject( m_lines );
+}
+
+DebugLineBatch::~DebugLineBatch()
+{
+    clearShapeCache();
+
+    if( m_lines->isAttached() )
+        m_lines->detachFromParent();
+    delete m_lines;
+}
+
+void DebugLineBatch::begin()
+{
+    m_vertices.clear();
+}
+
+void DebugLineBatch::addShape( const OgreNewt::Collision& shape, const Ogre::Vector3& pos, const Ogre::Quaternion& orient, const Ogre::ColourValue& colour )
+{
+    addLines( getShapeLines( shape ), pos, orient, colour );
+}
+
+void DebugLineBatch::addLines( const LineList& lines, const Ogre::Vector3& pos, const Ogre::Quaternion& orient, const Ogre::ColourValue& colour )
+{
+    Ogre::Matrix3 rot;
+    orient.ToRotationMatrix( rot );
+
+    size_t first = m_vertices.size();
+    m_vertices.resize( first + lines.size() );
+
+    for( size_t i = 0; i < lines.size(); i++ )
+    {
+        Vertex& v = m_vertices[first + i];
+        v.pos = rot * lines[i] + pos;
+        v.colour = colour;
+    }
+}
+
+void DebugLineBatch::addLine( const Ogre::Vector3& start, const Ogre::Vector3& end, const Ogre::ColourValue& colour )
+{
+    Vertex v;
+    v.colour = colour;
+    v.pos = start;
+    m_vertices.push_back( v );
+    v.pos = end;
+    m_vertices.push_back( v );
+}
+
+void DebugLineBatch::end()
+{
+    // everything drawn this frame is built already, shapes released since can go now
+    releaseUnusedShapes();
+
+    // an empty section can't be uploaded, just hide the batch until there is something to show
+    if( m_vertices.empty() )
+    {
+        m_lines->setVisible( false );
+        return;
+    }
+    m_lines->setVisible( true );
+
+    if( m_built )
+        m_lines->beginUpdate( 0 );
+    else
+        m_lines->begin( "BaseWhiteNoLighting", Ogre::RenderOperation::OT_LINE_LIST );
+
+    m_lines->estimateVertexCount( m_vertices.size() );
+    for( std::vector<Vertex>::const_iterator it = m_vertices.begin(); it != m_vertices.end(); it++ )
+    {
+        m_lines->position( it->pos );
+        m_lines->colour( it->colour );
+    }
+
+    m_lines->end();
+    m_built = true;
+}
+
+const DebugLineBatch::LineList& DebugLineBatch::getShapeLines( const OgreNewt::Collision& shape )
+{
+    const NewtonCollision* col = shape.getNewtonCollision();
+
+    ShapeCache::iterator it = m_shapes.find( col );
+    if( it != m_shapes.end() )
+        return it->second.lines;
+
+    // keep the shape alive as long as it is cached, so its address can't be reused by another shape
+    NewtonAddCollisionReference( (NewtonCollision*)col );
+
+    CachedShape& cached = m_shapes[col];
+    cached.world = shape.getWorld()->getNewtonWorld();
+    float matrix[16];
+    Converters::QuatPosToMatrix( Ogre::Quaternion::IDENTITY, Ogre::Vector3::ZERO, &matrix[0] );
+    NewtonCollisionForEachPolygonDo( col, &matrix[0], newtonPerPoly, &cached.lines );
+
+    return cached.lines;
+}
+
+void DebugLineBatch::clearShapeCache()
+{
+    for( ShapeCache::iterator it = m_shapes.begin(); it != m_shapes.end(); it++ )
+    {
+        NewtonReleaseCollision( it->second.world, it->first );
+    }
+    m_shapes.clear();
+}
+
+size_t DebugLineBatch::releaseUnusedShapes()
+{
+    size_t released = 0;
+    NewtonCollisionInfoRecord info;
+    for( ShapeCache::iterator it = m_shapes.begin(); it != m_shapes.end(); )
+    {
+        // the reference taken in getShapeLines is the last one, the shape is gone for everybody else
+        NewtonCollisionGetInfo( it->first, &info );
+        if( info.m_referenceCount <= 1 )
+        {
+            NewtonReleaseCollision( it->second.world, it->first );
+            m_shapes.erase( it++ );
+            released++;
+        }
+        else
+            it++;
+    }
+    return released;
+}
+
+void _CDECL DebugLineBatch::newtonPerPoly( void* userData, int vertexCount, const float* faceVertec, int id )
+{
+    LineList* lines = (LineList*)userData;
+    Ogre::Vector3 p0, p1;
+
+    if( vertexCount < 2 )
+        return;
+
+    int i = vertexCount - 1;
+    p0 = Ogre::Vector3( faceVertec[(i*3) + 0], faceVertec[(i*3) + 1], faceVertec[(i*3) + 2] );
+
+    for( i = 0; i < vertexCount; i++ )
+    {
+        p1 = Ogre::Vector3( faceVertec[(i*3) + 0], faceVertec[(i*3) + 1], faceVertec[(i*3) + 2] );
+
+        lines->push_back( p0 );
+        lines->push_back( p1 );
+
+        p0 = p1;
+    }
+}
+
+}   // end namespace OgreNewt
@@ -0,0 +1,111 @@
+/*
+    OgreNewt Library
+
+    Ogre implementation of Newton Game Dynamics SDK
+
+    OgreNewt basically has no license, you may use any or all of the library however you desire... I hope it can help you in any way.
+
+        by Walaber
+        some changes by melven
+
+*/
+#ifndef _INCLUDE_OGRENEWT_DEBUGLINEBATCH
+#define _INCLUDE_OGRENEWT_DEBUGLINEBATCH
+
+#include "OgreNewt_Prerequisites.h"
+
+#include <vector>
+#include <map>
+
+// OgreNewt namespace.  all functions and classes use this namespace.
+namespace OgreNewt
+{
+
+//! all debug lines of one frame in a single dynamic vertex buffer
+/*!
+    Instead of one Ogre::ManualObject per body, the Debugger writes every line of a frame into this batch.
+    The wireframe of each collision shape is generated only once, in local space, and shared by all bodies
+    using that shape; per frame the cached lines are just transformed by the body's position and orientation.
+    A cached shape lives until the frame after its last user released it, so temporary shapes (e.g. convex casts)
+    don't pile up.
+*/
+class _OgreNewtExport DebugLineBatch
+{
+public:
+    //! lines of a collision shape in local space, two points per line
+    typedef std::vector<Ogre::Vector3> LineList;
+
+    DebugLineBatch( Ogre::SceneNode* node, const Ogre::String& name );
+    ~DebugLineBatch();
+
+    //! start collecting the lines of a new frame
+    void begin();
+
+    //! add the (cached) wireframe of shape, placed at pos / orient
+    void addShape( const OgreNewt::Collision& shape, const Ogre::Vector3& pos, const Ogre::Quaternion& orient, const Ogre::ColourValue& colour );
+
+    //! add an arbitrary list of lines, transformed by pos / orient
+    void addLines( const LineList& lines, const Ogre::Vector3& pos, const Ogre::Quaternion& orient, const Ogre::ColourValue& colour );
+
+    //! add a single line in world space
+    void addLine( const Ogre::Vector3& start, const Ogre::Vector3& end, const Ogre::ColourValue& colour );
+
+    //! upload everything collected since begin() to the vertex buffer
+    /*!
+        Also drops the cached wireframes of shapes nobody but the cache references any more.
+    */
+    void end();
+
+    //! returns the cached local space wireframe of shape, building it on first use
+    const LineList& getShapeLines( const OgreNewt::Collision& shape );
+
+    //! forget all cached shapes
+    void clearShapeCache();
+
+    //! forget the cached shapes which were destroyed by their owner, returns how many were dropped
+    size_t releaseUnusedShapes();
+
+    //! number of shapes currently cached
+    size_t getShapeCount() const { return m_shapes.size(); }
+
+    //! number of lines drawn last frame
+    size_t getLineCount() const { return m_vertices.size() / 2; }
+
+private:
+    struct Vertex
+    {
+        Ogre::Vector3 pos;
+        Ogre::ColourValue colour;
+    };
+
+    struct CachedShape
+    {
+        const NewtonWorld* world;
+        LineList lines;
+    };
+
+    typedef std::map<const NewtonCollision*, CachedShape> ShapeCache;
+
+    static void _CDECL newtonPerPoly( void* userData, int vertexCount, const float* faceVertec, int id );
+
+    Ogre::SceneNode* m_node;
+    Ogre::ManualObject* m_lines;
+    bool m_built;
+
+    std::vector<Vertex> m_vertices;
+    ShapeCache m_shapes;
+};
+
+//! show the caption with mass, position, velocity, omega and inertia above every body, on by default
+/*!
+    Each caption is a MovableText of its own and costs a draw call per body; without them the Debugger
+    draws all bodies as its one line batch.
+*/
+_OgreNewtExport void setDebugShowBodyInfo( const Debugger* debugger, bool show );
+
+//! whether debugger shows the captions above the bodies
+_OgreNewtExport bool isDebugShowingBodyInfo( const Debugger* debugger );
+
+}   // end namespace OgreNewt
+
+#endif
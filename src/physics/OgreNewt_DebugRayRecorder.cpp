@@ -0,0 +1,193 @@
+#include "OgreNewt_stdafx.h"
+#include "OgreNewt_DebugRayRecorder.h"
+#include "OgreNewt_DebugLineBatch.h"
+#include "OgreNewt_World.h"
+#include "OgreNewt_Body.h"
+#include "OgreNewt_Collision.h"
+
+#ifdef __APPLE__
+#   include <Ogre/OgreRoot.h>
+#else
+#   include <OgreRoot.h>
+#endif
+
+namespace OgreNewt
+{
+
+DebugRayRecorder::DebugRayRecorder( const World* world, Ogre::SceneNode* node, const Ogre::String& name, size_t maxRecords )
+{
+    m_world = world;
+    m_batch = new DebugLineBatch( node, name );
+    m_next = m_count = m_dropped = 0;
+    m_dirty = false;
+
+    setMaxRecords( maxRecords );
+
+    Ogre::Root::getSingleton().addFrameListener( this );
+}
+
+DebugRayRecorder::~DebugRayRecorder()
+{
+    Ogre::Root::getSingleton().removeFrameListener( this );
+    delete m_batch;
+}
+
+void DebugRayRecorder::setMaxRecords( size_t maxRecords )
+{
+    if( maxRecords < 1 )
+        maxRecords = 1;
+
+    m_records.clear();
+    m_records.resize( maxRecords );
+    clear();
+}
+
+DebugRayRecorder::Record& DebugRayRecorder::nextRecord()
+{
+    Record& record = m_records[m_next];
+    m_next = (m_next + 1) % m_records.size();
+
+    if( m_count < m_records.size() )
+        m_count++;
+    else
+        m_dropped++;
+
+    m_dirty = true;
+    return record;
+}
+
+void DebugRayRecorder::addRay( const Ogre::Vector3& startpt, const Ogre::Vector3& endpt, const Ogre::ColourValue& colour )
+{
+    Record& record = nextRecord();
+    record.type = RT_RAY;
+    record.start = startpt;
+    record.end = endpt;
+    record.shape.reset();
+    record.colour = colour;
+}
+
+void DebugRayRecorder::addConvexRay( const OgreNewt::CollisionPtr& col, const Ogre::Vector3& startpt, const Ogre::Quaternion& colori, const Ogre::Vector3& endpt, const Ogre::ColourValue& colour )
+{
+    Record& record = nextRecord();
+    record.type = RT_CONVEX;
+    record.start = startpt;
+    record.end = endpt;
+    record.orient = colori;
+    record.shape = col;
+    record.colour = colour;
+}
+
+void DebugRayRecorder::addBody( const OgreNewt::Body* body, const Ogre::ColourValue& colour )
+{
+    Record& record = nextRecord();
+    record.type = RT_BODY;
+    body->getVisualPositionOrientation( record.start, record.orient );
+    record.shape = body->getCollision();
+    record.colour = colour;
+}
+
+void DebugRayRecorder::clear()
+{
+    // the records are the only users of temporary convex cast shapes, the next rebuild drops them from the cache
+    for( std::vector<Record>::iterator it = m_records.begin(); it != m_records.end(); it++ )
+        it->shape.reset();
+
+    m_next = m_count = m_dropped = 0;
+    m_dirty = true;
+}
+
+bool DebugRayRecorder::frameStarted( const Ogre::FrameEvent& evt )
+{
+#ifndef WIN32
+    m_world->ogreCriticalSectionLock();
+#endif
+    if( m_dirty )
+    {
+        rebuild();
+        m_dirty = false;
+    }
+#ifndef WIN32
+    m_world->ogreCriticalSectionUnlock();
+#endif
+    return true;
+}
+
+void DebugRayRecorder::addBoundingBox( const Ogre::Vector3* corners, const Ogre::ColourValue& colour )
+{
+    // same corner order as Ogre::AxisAlignedBox::getAllCorners
+    for( int i = 0; i < 4; i++ )
+    {
+        m_batch->addLine( corners[i], corners[(i+1)%4], colour );
+        m_batch->addLine( corners[i+4], corners[(i+1)%4+4], colour );
+    }
+    m_batch->addLine( corners[0], corners[6], colour );
+    m_batch->addLine( corners[1], corners[5], colour );
+    m_batch->addLine( corners[2], corners[4], colour );
+    m_batch->addLine( corners[3], corners[7], colour );
+}
+
+static void calculateCorners( const DebugLineBatch::LineList& lines, const Ogre::Vector3& pos, const Ogre::Quaternion& orient, Ogre::Vector3* corners )
+{
+    Ogre::Vector3 min( Ogre::Math::POS_INFINITY ), max( Ogre::Math::NEG_INFINITY );
+    for( DebugLineBatch::LineList::const_iterator it = lines.begin(); it != lines.end(); it++ )
+    {
+        Ogre::Vector3 p = orient * (*it) + pos;
+        min.makeFloor( p );
+        max.makeCeil( p );
+    }
+    if( lines.empty() )
+        min = max = pos;
+
+    corners[0] = min;
+    corners[1] = Ogre::Vector3( min.x, max.y, min.z );
+    corners[2] = Ogre::Vector3( max.x, max.y, min.z );
+    corners[3] = Ogre::Vector3( max.x, min.y, min.z );
+    corners[4] = max;
+    corners[5] = Ogre::Vector3( min.x, max.y, max.z );
+    corners[6] = Ogre::Vector3( min.x, min.y, max.z );
+    corners[7] = Ogre::Vector3( max.x, min.y, max.z );
+}
+
+void DebugRayRecorder::rebuild()
+{
+    m_batch->begin();
+
+    // oldest record first
+    size_t first = (m_next + m_records.size() - m_count) % m_records.size();
+    for( size_t n = 0; n < m_count; n++ )
+    {
+        const Record& record = m_records[(first + n) % m_records.size()];
+
+        switch( record.type )
+        {
+            case RT_RAY:
+                m_batch->addLine( record.start, record.end, record.colour );
+                break;
+
+            case RT_CONVEX:
+            {
+                const DebugLineBatch::LineList& lines = m_batch->getShapeLines( *record.shape );
+                Ogre::Vector3 corners1[8], corners2[8];
+                calculateCorners( lines, record.start, record.orient, corners1 );
+                calculateCorners( lines, record.end, record.orient, corners2 );
+
+                addBoundingBox( corners1, record.colour );
+                addBoundingBox( corners2, record.colour );
+                for( int i = 0; i < 8; i++ )
+                    m_batch->addLine( corners1[i], corners2[i], record.colour );
+
+                m_batch->addLines( lines, record.start, record.orient, record.colour );
+                m_batch->addLines( lines, record.end, record.orient, record.colour );
+                break;
+            }
+
+            case RT_BODY:
+                m_batch->addShape( *record.shape, record.start, record.orient, record.colour );
+                break;
+        }
+    }
+
+    m_batch->end();
+}
+
+}   // end namespace OgreNewt
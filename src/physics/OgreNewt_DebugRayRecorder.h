@@ -0,0 +1,110 @@
+/*
+    OgreNewt Library
+
+    Ogre implementation of Newton Game Dynamics SDK
+
+    OgreNewt basically has no license, you may use any or all of the library however you desire... I hope it can help you in any way.
+
+        by Walaber
+        some changes by melven
+
+*/
+#ifndef _INCLUDE_OGRENEWT_DEBUGRAYRECORDER
+#define _INCLUDE_OGRENEWT_DEBUGRAYRECORDER
+
+#include "OgreNewt_Prerequisites.h"
+
+#include <vector>
+
+#ifdef __APPLE__
+#   include <Ogre/OgreFrameListener.h>
+#else
+#   include <OgreFrameListener.h>
+#endif
+
+// OgreNewt namespace.  all functions and classes use this namespace.
+namespace OgreNewt
+{
+
+class DebugLineBatch;
+
+//! fixed size storage for the raycasts recorded by the Debugger
+/*!
+    Recorded rays, convex casts and hit / discarded bodies go into a ring buffer of at most getMaxRecords()
+    entries, older records are overwritten once it is full. Once per frame all records are drawn into one
+    DebugLineBatch, so recording costs the same no matter how many rays are cast, and nothing is allocated per ray.
+*/
+class _OgreNewtExport DebugRayRecorder : public Ogre::FrameListener
+{
+public:
+    DebugRayRecorder( const World* world, Ogre::SceneNode* node, const Ogre::String& name, size_t maxRecords = 1024 );
+    ~DebugRayRecorder();
+
+    //! change the size of the ring buffer, this clears all records
+    /*!
+        Not locked, use setDebugRaycastRecordingLimit to resize the recorder of a running Debugger.
+    */
+    void setMaxRecords( size_t maxRecords );
+    size_t getMaxRecords() const { return m_records.size(); }
+
+    //! number of records currently stored
+    size_t getRecordCount() const { return m_count; }
+    //! number of records which were overwritten because the buffer was full
+    size_t getDroppedCount() const { return m_dropped; }
+
+    void addRay( const Ogre::Vector3& startpt, const Ogre::Vector3& endpt, const Ogre::ColourValue& colour );
+    void addConvexRay( const OgreNewt::CollisionPtr& col, const Ogre::Vector3& startpt, const Ogre::Quaternion& colori, const Ogre::Vector3& endpt, const Ogre::ColourValue& colour );
+    void addBody( const OgreNewt::Body* body, const Ogre::ColourValue& colour );
+
+    void clear();
+
+    const World* getWorld() const { return m_world; }
+
+    //! redraws the line batch if something was recorded since the last frame
+    bool frameStarted( const Ogre::FrameEvent& evt );
+
+private:
+    enum RecordType
+    {
+        RT_RAY,
+        RT_CONVEX,
+        RT_BODY
+    };
+
+    struct Record
+    {
+        RecordType type;
+        Ogre::Vector3 start, end;
+        Ogre::Quaternion orient;
+        OgreNewt::CollisionPtr shape;
+        Ogre::ColourValue colour;
+    };
+
+    Record& nextRecord();
+    void addBoundingBox( const Ogre::Vector3* corners, const Ogre::ColourValue& colour );
+    void rebuild();
+
+    const World* m_world;
+    DebugLineBatch* m_batch;
+
+    std::vector<Record> m_records;
+    size_t m_next, m_count, m_dropped;
+    bool m_dirty;
+};
+
+//! returns the raycast recorder of debugger, NULL if the debugger hasn't been initialised
+_OgreNewtExport DebugRayRecorder* getDebugRayRecorder( const Debugger* debugger );
+
+//! set how many raycasts debugger keeps at most, 1024 by default
+/*!
+    Applies to the recorder created by the next Debugger::init as well as to a running one,
+    whose records are cleared.
+*/
+_OgreNewtExport void setDebugRaycastRecordingLimit( const Debugger* debugger, size_t maxRecords );
+
+//! the raycast limit of debugger
+_OgreNewtExport size_t getDebugRaycastRecordingLimit( const Debugger* debugger );
+
+}   // end namespace OgreNewt
+
+#endif
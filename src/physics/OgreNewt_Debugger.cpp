@@ -4,11 +4,17 @@
 #include "OgreNewt_Body.h"
 #include "OgreNewt_Joint.h"
 #include "OgreNewt_Collision.h"
+#include "OgreNewt_DebugLineBatch.h"
+#include "OgreNewt_DebugRayRecorder.h"
 
 #include <NewtonCustomJoint.h>
 
 #include <sstream>
 
+#ifndef WIN32
+#   include <pthread.h>
+#endif
+
 #ifdef __APPLE__
 #   include <Ogre/OgreSceneNode.h>
 #   include <Ogre/OgreSceneManager.h>
@@ -22,6 +28,100 @@
 namespace OgreNewt
 {
 
+// the line batches and settings of each debugger are kept here instead of as members,
+// so the Debugger's layout stays the one of the installed OgreNewt headers
+struct DebuggerExtras
+{
+    DebuggerExtras() : lines(NULL), rays(NULL), maxRays(1024), showBodyInfo(true) {}
+    DebugLineBatch* lines;
+    DebugRayRecorder* rays;
+    size_t maxRays;
+    bool showBodyInfo;
+};
+
+typedef std::map<const Debugger*, DebuggerExtras> DebuggerExtrasMap;
+static DebuggerExtrasMap s_extras;
+#ifndef WIN32
+// every world has its own debugger, and worlds may live in different threads
+static pthread_mutex_t s_extrasMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// the map's nodes never move, so the returned entry stays valid until eraseExtras
+static DebuggerExtras& getExtras( const Debugger* debugger )
+{
+#ifndef WIN32
+    pthread_mutex_lock( &s_extrasMutex );
+#endif
+    DebuggerExtras& extras = s_extras[debugger];
+#ifndef WIN32
+    pthread_mutex_unlock( &s_extrasMutex );
+#endif
+    return extras;
+}
+
+static void eraseExtras( const Debugger* debugger )
+{
+#ifndef WIN32
+    pthread_mutex_lock( &s_extrasMutex );
+#endif
+    s_extras.erase( debugger );
+#ifndef WIN32
+    pthread_mutex_unlock( &s_extrasMutex );
+#endif
+}
+
+static void destroyLineBatch( const Debugger* debugger )
+{
+    DebuggerExtras& extras = getExtras( debugger );
+    delete extras.lines;
+    extras.lines = NULL;
+}
+
+static void destroyRayRecorder( const Debugger* debugger )
+{
+    DebuggerExtras& extras = getExtras( debugger );
+    delete extras.rays;
+    extras.rays = NULL;
+}
+
+DebugRayRecorder* getDebugRayRecorder( const Debugger* debugger )
+{
+    return getExtras( debugger ).rays;
+}
+
+void setDebugRaycastRecordingLimit( const Debugger* debugger, size_t maxRecords )
+{
+    DebuggerExtras& extras = getExtras( debugger );
+    extras.maxRays = maxRecords;
+
+    DebugRayRecorder* rays = extras.rays;
+    if( !rays )
+        return;
+
+#ifndef WIN32
+    rays->getWorld()->ogreCriticalSectionLock();
+#endif
+    rays->setMaxRecords( maxRecords );
+#ifndef WIN32
+    rays->getWorld()->ogreCriticalSectionUnlock();
+#endif
+}
+
+size_t getDebugRaycastRecordingLimit( const Debugger* debugger )
+{
+    return getExtras( debugger ).maxRays;
+}
+
+void setDebugShowBodyInfo( const Debugger* debugger, bool show )
+{
+    getExtras( debugger ).showBodyInfo = show;
+}
+
+bool isDebugShowingBodyInfo( const Debugger* debugger )
+{
+    return getExtras( debugger ).showBodyInfo;
+}
+
 //////////////////////////////////////////////////////////
 // DEUBBER FUNCTIONS
 //////////////////////////////////////////////////////////
@@ -43,6 +143,7 @@ Debugger::Debugger(const OgreNewt::World* world)
 Debugger::~Debugger()
 {
     deInit();
+    eraseExtras(this);
 }
 
 void Debugger::init( Ogre::SceneManager* smgr )
@@ -51,12 +152,21 @@ void Debugger::init( Ogre::SceneManager* smgr )
     {
         m_debugnode = smgr->getRootSceneNode()->createChildSceneNode("__OgreNewt__Debugger__Node__");
         m_debugnode->setListener(this);
+
+        std::ostringstream oss;
+        oss << "__OgreNewt__Debugger__Lines__" << this << "__";
+        getExtras(this).lines = new DebugLineBatch(m_debugnode, oss.str());
     }
 
     if( !m_raycastsnode )
     {
         m_raycastsnode = smgr->getRootSceneNode()->createChildSceneNode("__OgreNewt__Raycasts_Debugger__Node__");
         m_raycastsnode->setListener(this);
+
+        std::ostringstream oss;
+        oss << "__OgreNewt__Raycast_Debugger__Lines__" << this << "__";
+        DebuggerExtras& extras = getExtras(this);
+        extras.rays = new DebugRayRecorder(m_world, m_raycastsnode, oss.str(), extras.maxRays);
     }
 
 	m_sceneManager = smgr;
@@ -65,6 +175,7 @@ void Debugger::init( Ogre::SceneManager* smgr )
 void Debugger::deInit()
 {
     clearBodyDebugDataCache();
+    destroyLineBatch(this);
     if (m_debugnode)
     {
         m_debugnode->setListener(NULL);
@@ -75,6 +186,7 @@ void Debugger::deInit()
 
 
     clearRaycastsRecorded();
+    destroyRayRecorder(this);
     if( m_raycastsnode )
     {
         m_raycastsnode->setListener(NULL);
@@ -90,12 +202,14 @@ void Debugger::nodeDestroyed (const Ogre::Node *node)
     {
         m_debugnode = NULL;
         clearBodyDebugDataCache();
+        destroyLineBatch(this);
     }
 
     if(node == m_raycastsnode)
     {
         m_raycastsnode = NULL;
         clearRaycastsRecorded();
+        destroyRayRecorder(this);
     }
 }
 
@@ -123,11 +237,14 @@ void Debugger::showDebugInformation( )
 
     m_debugnode->removeAllChildren();
 
-    // make the new lines.
+    // make the new lines, all bodies share one vertex buffer
+    DebugLineBatch* lines = getExtras(this).lines;
+    lines->begin();
     for( Body* body = m_world->getFirstBody(); body; body = body->getNext() )
     {
         processBody(body);
     }
+    lines->end();
     
 	// display any joint debug information
 	NewtonWorldForEachJointDo (m_world->getNewtonWorld(), newtonprocessJoints, this);
@@ -155,7 +272,14 @@ void Debugger::hideDebugInformation()
 {
     // erase any existing lines!
     if( m_debugnode )
+    {
         m_debugnode->removeAllChildren();
+
+        // the batch is attached to the debug node itself, an empty frame hides it
+        DebugLineBatch* lines = getExtras(this).lines;
+        lines->begin();
+        lines->end();
+    }
 }
 
 void Debugger::setMaterialColor(const MaterialID* mat, Ogre::ColourValue col)
@@ -213,13 +337,18 @@ void Debugger::processBody( OgreNewt::Body* bod )
     Ogre::Vector3 pos, vel, omega;
     Ogre::Quaternion ori;
     bod->getVisualPositionOrientation(pos, ori);
+
+    // the wireframe itself is cached per collision shape and written to the shared line batch
+    const DebuggerExtras& extras = getExtras(this);
+    extras.lines->addShape( *bod->getCollision(), pos, ori, (it != m_materialcolors.end()) ? it->second : m_defaultcolor );
+
+    if( !extras.showBodyInfo )
+        return;
 	
 	vel = bod->getVelocity();
 	omega = bod->getOmega();
 
 	// ----------- create debug-text ------------
-	std::ostringstream oss_name;
-	oss_name << "__OgreNewt__Debugger__Body__" << bod << "__";
 	std::ostringstream oss_info;
 	oss_info.precision(2);
 	oss_info.setf(std::ios::fixed,std::ios::floatfield);
@@ -239,73 +368,32 @@ void Debugger::processBody( OgreNewt::Body* bod )
     // look for cached data
     BodyDebugData* data = &m_cachemap[bod];
 
-    if( data->m_lastcol == bod->getCollision() ) // use cached data
+    if( data->m_node ) // only the transform and caption change from frame to frame
     {
-        // set new position...
         data->m_node->setPosition(pos);
         data->m_node->setOrientation(ori);
-        data->m_updated = 1;
         m_debugnode->addChild(data->m_node);
+    }
+    else
+        data->m_node = m_debugnode->createChildSceneNode(pos, ori);
+
+    data->m_lastcol = bod->getCollision();
+    data->m_updated = 1;
+
+    if( data->m_text )
+    {
         data->m_text->setCaption(oss_info.str());
         data->m_text->setLocalTranslation(bod->getAABB().getSize().y*1.1*Ogre::Vector3::UNIT_Y);
     }
     else
     {
-        data->m_lastcol = bod->getCollision();
-        data->m_updated = 1;
-
-        if( data->m_node )
-        {
-            data->m_node->detachAllObjects();
-            data->m_node->setPosition(pos);
-            data->m_node->setOrientation(ori);
-        }
-        else
-            data->m_node = m_debugnode->createChildSceneNode(pos, ori);
-
-        if( data->m_lines )
-		{
-            data->m_lines->clear();
-		}
-        else
-        {
-            std::ostringstream oss;
-            oss << "__OgreNewt__Debugger__Lines__" << bod << "__";
-            data->m_lines = new Ogre::ManualObject(oss.str());
-        }
-
-        if( data->m_text )
-        {
-            data->m_text->setCaption(oss_info.str());
-            data->m_text->setLocalTranslation(bod->getAABB().getMaximum().y*1.1*Ogre::Vector3::UNIT_Y);
-        }
-        else
-        {
-            data->m_text = new OgreNewt::OgreAddons::MovableText( oss_name.str(), oss_info.str(), "BlueHighway-10",0.5);
-            data->m_text->setLocalTranslation(bod->getAABB().getMaximum().y/2*Ogre::Vector3::UNIT_Y+Ogre::Vector3::UNIT_Y*0.1);
-            data->m_text->setTextAlignment( OgreNewt::OgreAddons::MovableText::H_LEFT, OgreNewt::OgreAddons::MovableText::V_ABOVE );
-        }
-
+        // the name is only needed once, so it isn't built every frame
+        std::ostringstream oss_name;
+        oss_name << "__OgreNewt__Debugger__Body__" << bod << "__";
+        data->m_text = new OgreNewt::OgreAddons::MovableText( oss_name.str(), oss_info.str(), "BlueHighway-10",0.5);
+        data->m_text->setLocalTranslation(bod->getAABB().getMaximum().y/2*Ogre::Vector3::UNIT_Y+Ogre::Vector3::UNIT_Y*0.1);
+        data->m_text->setTextAlignment( OgreNewt::OgreAddons::MovableText::H_LEFT, OgreNewt::OgreAddons::MovableText::V_ABOVE );
         data->m_node->attachObject(data->m_text);
-        
-/*
-        data->m_lines->begin("BaseWhiteNoLighting", Ogre::RenderOperation::OT_LINE_LIST );
-
-        // set color
-        if( it != m_materialcolors.end() )
-            data->m_lines->colour(it->second);
-        else
-            data->m_lines->colour(m_defaultcolor);
-
-        float matrix[16];
-        Converters::QuatPosToMatrix(Ogre::Quaternion::IDENTITY, Ogre::Vector3::ZERO, &matrix[0]);
-        
-        NewtonCollisionForEachPolygonDo( NewtonBodyGetCollision(newtonBody), &matrix[0], newtonPerPoly, data->m_lines );
-        data->m_lines->end();
-*/
-		buildDebugObjectFromCollision (data->m_lines, m_defaultcolor, *bod->getCollision());
-
-        data->m_node->attachObject(data->m_lines);
     }
 }
 
@@ -356,22 +444,17 @@ bool Debugger::isRaycastRecordingHitBodies()
 
 void Debugger::clearRaycastsRecorded()
 {
-    if( m_raycastsnode )
-    {
-/*
-        while( m_raycastsnode->numAttachedObjects() > 0 )
-        {
-            delete m_raycastsnode->detachObject((unsigned short)0);
-        }
-*/
-        m_raycastsnode->removeAndDestroyAllChildren();
-    }
+    DebugRayRecorder* rays = getDebugRayRecorder(this);
+    if( !rays )
+        return;
 
-    for(ManualObjectList::iterator it = mRecordedRaycastObjects.begin(); it != mRecordedRaycastObjects.end(); it++)
-    {
-        delete (*it);
-    }
-    mRecordedRaycastObjects.clear();
+#ifndef WIN32
+    m_world->ogreCriticalSectionLock();
+#endif
+    rays->clear();
+#ifndef WIN32
+    m_world->ogreCriticalSectionUnlock();
+#endif
 }
 
 void Debugger::stopRaycastRecording()
@@ -389,25 +472,14 @@ void Debugger::setRaycastRecordingColor(Ogre::ColourValue rayCol, Ogre::ColourVa
 
 void Debugger::addRay(const Ogre::Vector3 &startpt, const Ogre::Vector3 &endpt)
 {
-    if (!m_raycastsnode)
+    DebugRayRecorder* rays = getDebugRayRecorder(this);
+    if (!rays)
         return;
 
-    static int i = 0;
-    std::ostringstream oss;
-    oss << "__OgreNewt__Raycast_Debugger__Lines__Raycastline__" << i++ << "__";
-    Ogre::ManualObject *line = new Ogre::ManualObject(oss.str());
-
-    line->begin("BaseWhiteNoLighting", Ogre::RenderOperation::OT_LINE_LIST );
-    line->colour(m_raycol);
-    line->position(startpt);
-    line->position(endpt);
-    line->end();
-
 #ifndef WIN32
     m_world->ogreCriticalSectionLock();
 #endif
-    mRecordedRaycastObjects.push_back(line);
-    m_raycastsnode->attachObject(line);
+    rays->addRay(startpt, endpt, m_raycol);
 #ifndef WIN32
     m_world->ogreCriticalSectionUnlock();
 #endif
@@ -415,57 +487,14 @@ void Debugger::addRay(const Ogre::Vector3 &startpt, const Ogre::Vector3 &endpt)
 
 void Debugger::addConvexRay(const OgreNewt::ConvexCollisionPtr& col, const Ogre::Vector3 &startpt, const Ogre::Quaternion &colori, const Ogre::Vector3 &endpt)
 {
-    if (!m_raycastsnode)
+    DebugRayRecorder* rays = getDebugRayRecorder(this);
+    if (!rays)
         return;
 
-    static int i = 0;
-    // lines from aab
-    std::ostringstream oss;
-    oss << "__OgreNewt__Raycast_Debugger__Lines__Convexcastlines__" << i++ << "__";
-    Ogre::ManualObject *line = new Ogre::ManualObject(oss.str());
-
-    line->begin("BaseWhiteNoLighting", Ogre::RenderOperation::OT_LINE_LIST );
-    line->colour(m_convexcol);
-
-    // aab1
-    Ogre::AxisAlignedBox aab1 = col->getAABB(colori, startpt);
-    const Ogre::Vector3* corners1 = aab1.getAllCorners();
-    Ogre::AxisAlignedBox aab2 = col->getAABB(colori, endpt);
-    const Ogre::Vector3* corners2 = aab2.getAllCorners();
-    for(int i = 0; i < 4; i++)
-    {
-        line->position(corners1[i]); line->position(corners1[(i+1)%4]);
-        line->position(corners1[i+4]); line->position(corners1[(i+1)%4+4]);
-        line->position(corners2[i]); line->position(corners2[(i+1)%4]);
-        line->position(corners2[i+4]); line->position(corners2[(i+1)%4+4]);
-        line->position(corners1[i]); line->position(corners2[i]);
-        line->position(corners1[i+4]); line->position(corners2[i+4]);
-    }
-    line->position(corners1[0]); line->position(corners1[6]);
-    line->position(corners1[1]); line->position(corners1[5]);
-    line->position(corners1[2]); line->position(corners1[4]);
-    line->position(corners1[3]); line->position(corners1[7]);
-    line->position(corners2[0]); line->position(corners2[6]);
-    line->position(corners2[1]); line->position(corners2[5]);
-    line->position(corners2[2]); line->position(corners2[4]);
-    line->position(corners2[3]); line->position(corners2[7]);
-
-    // bodies
-    float matrix[16];
-    Converters::QuatPosToMatrix(colori, startpt, &matrix[0]);
-    NewtonCollisionForEachPolygonDo( col->getNewtonCollision(), &matrix[0], newtonPerPoly, line );
-    Converters::QuatPosToMatrix(colori, endpt, &matrix[0]);
-    NewtonCollisionForEachPolygonDo( col->getNewtonCollision(), &matrix[0], newtonPerPoly, line );
-
-
-    line->end();
-
-
 #ifndef WIN32
     m_world->ogreCriticalSectionLock();
 #endif
-    mRecordedRaycastObjects.push_back(line);
-    m_raycastsnode->attachObject(line);
+    rays->addConvexRay(col, startpt, colori, endpt, m_convexcol);
 #ifndef WIN32
     m_world->ogreCriticalSectionUnlock();
 #endif
@@ -473,33 +502,14 @@ void Debugger::addConvexRay(const OgreNewt::ConvexCollisionPtr& col, const Ogre:
 
 void Debugger::addDiscardedBody(const OgreNewt::Body* body)
 {
-    if (!m_raycastsnode)
+    DebugRayRecorder* rays = getDebugRayRecorder(this);
+    if (!rays)
         return;
 
-    static int i = 0;
-    float matrix[16];
-    Ogre::Vector3 pos;
-    Ogre::Quaternion ori;
-
-    std::ostringstream oss;
-    oss << "__OgreNewt__Raycast_Debugger__Lines__DiscardedBody__" << i++ << "__";
-    Ogre::ManualObject *line = new Ogre::ManualObject(oss.str());
-
-    line->begin("BaseWhiteNoLighting", Ogre::RenderOperation::OT_LINE_LIST );
-    line->colour(m_prefilterdiscardedcol);
-
-    body->getVisualPositionOrientation(pos, ori);
-    Converters::QuatPosToMatrix(ori, pos, &matrix[0]);
-    NewtonCollisionForEachPolygonDo( body->getCollision()->getNewtonCollision() , &matrix[0], newtonPerPoly, line );
-
-    line->end();
-
-
 #ifndef WIN32
     m_world->ogreCriticalSectionLock();
 #endif
-    mRecordedRaycastObjects.push_back(line);
-    m_raycastsnode->attachObject(line);
+    rays->addBody(body, m_prefilterdiscardedcol);
 #ifndef WIN32
     m_world->ogreCriticalSectionUnlock();
 #endif
@@ -507,32 +517,14 @@ void Debugger::addDiscardedBody(const OgreNewt::Body* body)
 
 void Debugger::addHitBody(const OgreNewt::Body* body)
 {
-    if (!m_raycastsnode)
+    DebugRayRecorder* rays = getDebugRayRecorder(this);
+    if (!rays)
         return;
 
-    static int i = 0;
-    float matrix[16];
-    Ogre::Vector3 pos;
-    Ogre::Quaternion ori;
-
-    std::ostringstream oss;
-    oss << "__OgreNewt__Raycast_Debugger__Lines__HitBody__" << i++ << "__";
-    Ogre::ManualObject *line = new Ogre::ManualObject(oss.str());
-
-    line->begin("BaseWhiteNoLighting", Ogre::RenderOperation::OT_LINE_LIST );
-    line->colour(m_hitbodycol);
-
-    body->getVisualPositionOrientation(pos, ori);
-    Converters::QuatPosToMatrix(ori, pos, &matrix[0]);
-    NewtonCollisionForEachPolygonDo( body->getCollision()->getNewtonCollision() , &matrix[0], newtonPerPoly, line );
-
-    line->end();
-
 #ifndef WIN32
     m_world->ogreCriticalSectionLock();
 #endif
-    mRecordedRaycastObjects.push_back(line);
-    m_raycastsnode->attachObject(line);
+    rays->addBody(body, m_hitbodycol);
 #ifndef WIN32
     m_world->ogreCriticalSectionUnlock();
 #endif
@@ -0,0 +1,55 @@
+//
+// C++ Implementation: ccdpolicy
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "ccdpolicy.h"
+
+void CCDPolicy::update(OgreNewt::World* world, Ogre::Real timestep)
+{
+	for( OgreNewt::Body* body = world->getFirstBody(); body; body = body->getNext() )
+	{
+		evaluate(body, timestep);
+	}
+}
+
+bool CCDPolicy::evaluate(OgreNewt::Body* body, Ogre::Real timestep)
+{
+	NewtonBody* newtonBody = body->getNewtonBody();
+	bool active = NewtonBodyGetContinuousCollisionMode(newtonBody) != 0;
+
+	Ogre::Real mass;
+	Ogre::Vector3 inertia;
+	body->getMassMatrix(mass, inertia);
+	// static geometry never needs CCD
+	if( mass <= 0.0f )
+		return active;
+
+	Ogre::Vector3 size = body->getAABB().getSize();
+	Ogre::Real extent = std::min(size.x, std::min(size.y, size.z));
+	Ogre::Real travel = body->getVelocity().length() * timestep;
+	Ogre::Real threshold = fraction * extent;
+
+	if( !active && travel > threshold )
+	{
+		body->setContinuousCollisionMode(1);
+		++ccdBodies;
+		++enabled;
+		return true;
+	}
+	else if( active && travel < threshold * 0.5f )
+	{
+		body->setContinuousCollisionMode(0);
+		--ccdBodies;
+		++disabled;
+		return false;
+	}
+	return active;
+}
@@ -0,0 +1,45 @@
+//
+// C++ Interface: ccdpolicy
+//
+// Description: Switches Newton's continuous collision mode on only for bodies
+// which move fast compared to their own size.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#ifndef CCDPOLICY_H
+#define CCDPOLICY_H
+
+#include "OgreNewt.h"
+
+/** A body is put into continuous collision mode once the distance it covers in one
+ * timestep exceeds fraction times the smallest extent of its AABB, and taken out again
+ * once it drops below half of that, so bodies near the threshold don't flicker.
+ **/
+class CCDPolicy
+{
+	public:
+		CCDPolicy(Ogre::Real fraction = 0.5f) : fraction(fraction), ccdBodies(0), enabled(0), disabled(0) { }
+
+		/** evaluates every dynamic body of world **/
+		void update(OgreNewt::World* world, Ogre::Real timestep);
+		/** evaluates a single body, returns whether it is in CCD mode afterwards **/
+		bool evaluate(OgreNewt::Body* body, Ogre::Real timestep);
+
+		/** number of bodies currently in continuous collision mode **/
+		int getCCDBodies() const { return ccdBodies; }
+		/** how often CCD was switched on / off since startup **/
+		int getEnabledCount() const { return enabled; }
+		int getDisabledCount() const { return disabled; }
+
+	private:
+		Ogre::Real fraction;
+		int ccdBodies;
+		int enabled, disabled;
+};
+
+#endif
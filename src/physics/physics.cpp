@@ -14,11 +14,24 @@
 #include "resourcemanager.h"
 #include "objectregistry.h"
 #include "timer.h"
+#include "settingsmanager.h"
+#include "worldshards.h"
+#include "ccdpolicy.h"
+#include "physicsstate.h"
+#include "startupprofiler.h"
+#include "jobsystem.h"
+#include "levelfile.h"
+#include "entitystore.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "allocationtracker.h"
 
 #include "Ogre.h"
 #include "OgreNewt.h"
 #include "FeedDataTypes.h"
 
+#include <cstdlib>
+#include <map>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
@@ -43,18 +56,70 @@ class PhysicsImpl : public Task
 		void handleKeyEvents(const DataContainer& data);
 		void handleObjectEvents(const DataContainer& data);
 		void handleTerrainEvents(const DataContainer& data);
+		void handleLevelEvents(const DataContainer& data);
+		/** physics_capture and physics_restore, they wait for the current step to finish **/
+		void handleCaptureEvents(const DataContainer& data);
+		void handleRestoreEvents(const DataContainer& data);
+		
+		/** catches the simulation up with elapsed seconds of real time and posts the new world_dynamic **/
+		void simulate(Ogre::Real elapsed);
+		/** steps the simulation by timestep and re-evaluates which bodies need CCD **/
+		void stepWorld(Ogre::Real timestep);
+		/** copies the transforms of all bodies into their entities and worldGraph, one pass over the dense arrays **/
+		void takeSnapshot();
+		/** creates the terrain whose meshes finished loading in the background **/
+		void createLoadedTerrain();
+		/** imports the collision the level compiler built for specification at scale, null if there is none **/
+		OgreNewt::CollisionPtr loadBakedCollision(const std::string& specification, const Ogre::Vector3& scale, level_collision_type type, OgreNewt::World* world);
 		
 		//void handleTransform(OgreNewt::Body* body , const Ogre::Quaternion& orient, const Ogre::Vector3& pos, int threadIndex);
 	private:
+		/** every object physics knows, dynamic ones with their body, guarded by worldGraphMutex **/
+		EntityStore entities;
+		/** reused by takeSnapshot **/
+		std::vector<Archetype*> moving;
+		/** the snapshot posted on world_dynamic **/
 		WorldGraph worldGraph;
-		OgreNewt::World* m_World;
+		/** the payload of world_dynamic, always the same pointer, so it is only wrapped once **/
+		DataContainer worldGraphData;
+		WorldShards* shards;
+		CCDPolicy ccdPolicy;
 		int desired_framerate;
 		Ogre::Real m_update, m_elapsed;
 		
 		double workTime, overheadTime;
 		int frames;
 		
+		/** live metrics, registered in threadWillStart **/
+		Histogram* stepTime;
+		Histogram* substeps;
+		Counter* framesSimulated;
+		Gauge* bodiesActive;
+		Gauge* bodiesAsleep;
+		Gauge* snapshotSize;
+		/** allocations of every simulated frame, created in threadWillStart **/
+		FrameAllocations* allocations;
+		/** an object was added since the last frame, so this one may allocate; guarded by worldGraphMutex **/
+		bool sceneChanged;
+		
+		/** with JOB_SYSTEM the simulation runs as a job, time passing meanwhile is collected in unsimulatedTime **/
+		JobCounter simulationJob;
+		Ogre::Real unsimulatedTime;
+		
 		boost::mutex worldGraphMutex;
+		
+		/** terrain waiting for its mesh, guarded by terrainMutex **/
+		std::vector< std::pair<ResourceHandle, Terrain> > pendingTerrain;
+		boost::mutex terrainMutex;
+		
+		/** the current level, its prebuilt collisions are used instead of building them from meshes **/
+		boost::shared_ptr<LevelFile> level;
+		/** every baked collision is imported once per world and shared by all bodies using it **/
+		std::map< std::pair<const void*, OgreNewt::World*>, OgreNewt::CollisionPtr > bakedCollisions;
+		/** guards level and bakedCollisions **/
+		boost::mutex levelMutex;
+		/** tree collisions built from meshes, by specification and scale, guarded by worldGraphMutex **/
+		std::map<std::string, OgreNewt::CollisionPtr> meshCollisions;
 };
 
 Physics::Physics() : impl(new PhysicsImpl) { }
@@ -63,23 +128,42 @@ bool Physics::doStep() { return impl->step(); }
 void Physics::threadWillStart() { impl->threadWillStart(); }
 void Physics::threadWillStop() { impl->threadWillStop(); }
 
-PhysicsImpl::PhysicsImpl() : desired_framerate(150), m_elapsed(0.0f), workTime(0.0), overheadTime(0.0), frames(0)
+PhysicsImpl::PhysicsImpl() : worldGraphData(&worldGraph), shards(NULL), desired_framerate(150), m_elapsed(0.0f), workTime(0.0), overheadTime(0.0), frames(0), stepTime(NULL), substeps(NULL), framesSimulated(NULL), bodiesActive(NULL), bodiesAsleep(NULL), snapshotSize(NULL), allocations(NULL), sceneChanged(false), unsimulatedTime(0.0f)
 {
-	m_World = new OgreNewt::World();
-	m_World->setWorldSize(Ogre::Vector3(-1000.0,-1000.0,-1000.0), Ogre::Vector3(1000.0,1000.0,1000.0));
-
 	m_update = (Ogre::Real)(1.0f / (Ogre::Real)desired_framerate);
 }
 
 PhysicsImpl::~PhysicsImpl()
 {
-	delete m_World;
+	delete shards;
+	delete allocations;
 }
 
 bool PhysicsImpl::doStep()
+{
+#ifdef JOB_SYSTEM
+	// all tasks are stepped by one thread then, so the simulation must not block it
+	unsimulatedTime += timeSinceLastFrame();
+	if (simulationJob.done())
+	{
+		JobSystem::Instance().submit(boost::bind(&PhysicsImpl::simulate, this, unsimulatedTime), &simulationJob);
+		unsimulatedTime = 0.0f;
+	}
+#else
+	simulate(timeSinceLastFrame());
+	boost::this_thread::sleep(boost::posix_time::milliseconds( 10.0f ));
+#endif
+	return running;
+}
+
+void PhysicsImpl::simulate(Ogre::Real elapsed)
 {
 	Timer timer;
-	m_elapsed += timeSinceLastFrame();
+	allocations->begin();
+	m_elapsed += elapsed;
+	createLoadedTerrain();
+	int steps = 0;
+	int migrations = shards->getMigrations();
 
 	// loop through and update as many times as necessary (up to 10 times maximum).
 	if ((m_elapsed > m_update) && (m_elapsed < (m_update * 10)) )
@@ -87,15 +171,18 @@ bool PhysicsImpl::doStep()
 		while (m_elapsed > m_update)
 		{
 			boost::mutex::scoped_lock lock(worldGraphMutex);
-			m_World->update( m_update );
+			stepWorld( m_update );
 			m_elapsed -= m_update;
+			steps++;
 		}
 	}
 	else
 	{
 		if (m_elapsed < (m_update))
 		{
+#ifndef JOB_SYSTEM
 			boost::this_thread::sleep(boost::posix_time::milliseconds( 500.0f / desired_framerate ));	// Wait half the duration of one frame
+#endif
 		}
 		else
 		{
@@ -103,45 +190,132 @@ bool PhysicsImpl::doStep()
             // this often happens on the first frame of a game, where assets and other things were loading, then
             // the elapsed time since the last drawn frame is very long.
 			boost::mutex::scoped_lock lock(worldGraphMutex);
-			m_World->update( m_elapsed );
+			stepWorld( m_elapsed );
 			m_elapsed = 0.0f; // reset the elapsed time so we don't become "eternally behind".
+			steps++;
 		}
 	}
-	boost::this_thread::sleep(boost::posix_time::milliseconds( 10.0f ));
+	substeps->observe(steps);
+	framesSimulated->add();
+	boost::mutex::scoped_lock lock(worldGraphMutex);
+	takeSnapshot();
+	// the post isn't counted, the handlers of the other tasks run in it
+	allocations->end( !sceneChanged && shards->getMigrations() == migrations );
+	sceneChanged = false;
 	workTime += timer.time();
 	timer.reset();
-	boost::mutex::scoped_lock lock(worldGraphMutex);
-	InformationManager::Instance()->postDataToFeed( "world_dynamic", DataContainer(&worldGraph) );
+	{
+		PROFILE_ZONE("physics post");
+		InformationManager::Instance()->postDataToFeed( "world_dynamic", worldGraphData );
+	}
 	overheadTime += timer.time();
 	frames++;
-	return running;
+}
+
+void PhysicsImpl::stepWorld(Ogre::Real timestep)
+{
+	PROFILE_ZONE("physics update");
+	Timer timer;
+	shards->update( timestep, entities );
+	worldGraph.time += timestep;
+	for(int i = 0; i < shards->getShardCount(); i++)
+	{
+		ccdPolicy.update( shards->getWorld(i), timestep );
+	}
+	stepTime->observe(timer.time());
+}
+
+void PhysicsImpl::takeSnapshot()
+{
+	PROFILE_ZONE("physics snapshot");
+	worldGraph.clear();
+	int asleep = 0;
+	entities.query(COMPONENT_BODY | COMPONENT_TRANSFORM, moving);
+	foreach(Archetype* archetype, moving)
+	{
+		for(size_t i = 0; i < archetype->size(); i++)
+		{
+			archetype->bodies[i]->getPositionOrientation(archetype->transforms[i].pos, archetype->transforms[i].orient);
+			asleep += NewtonBodyGetSleepState(archetype->bodies[i]->getNewtonBody()) ? 1 : 0;
+		}
+		worldGraph.ids.insert(worldGraph.ids.end(), archetype->ids.begin(), archetype->ids.end());
+		worldGraph.transforms.insert(worldGraph.transforms.end(), archetype->transforms.begin(), archetype->transforms.end());
+	}
+	bodiesAsleep->set(asleep);
+	bodiesActive->set(worldGraph.size() - asleep);
+	snapshotSize->set(worldGraph.size());
+}
+
+/** Newton allocates through these, so its allocations show up in FrameAllocations **/
+static void* _CDECL newtonAlloc(int size)
+{
+	countExternalAllocation(size);
+	return malloc(size);
+}
+
+static void _CDECL newtonFree(void* const ptr, int size)
+{
+	countExternalDeallocation();
+	free(ptr);
 }
 
 void PhysicsImpl::threadWillStart()
 {
+	Profiler::Instance().nameThread("physics");
+	Metrics& metrics = Metrics::Instance();
+	stepTime = &metrics.histogram("physics_step_seconds", "Time one physics step takes, including shard migration and CCD", Histogram::exponentialBounds(0.00025, 2.0, 10));
+	substeps = &metrics.histogram("physics_substeps_per_frame", "Physics steps needed to catch up with real time per frame", Histogram::exponentialBounds(1.0, 2.0, 4));
+	framesSimulated = &metrics.counter("physics_frames_total", "Physics frames, each with any number of steps");
+	bodiesActive = &metrics.gauge("physics_bodies_active", "Dynamic bodies Newton is simulating");
+	bodiesAsleep = &metrics.gauge("physics_bodies_asleep", "Dynamic bodies at rest, which Newton skips");
+	snapshotSize = &metrics.gauge("physics_snapshot_objects", "Objects in the last world_dynamic snapshot");
+	allocations = new FrameAllocations("physics", true, boost::any_cast<int>(SettingsManager::Instance().getSetting("assert_no_allocations").data) != 0);
+	// graphics interpolates between the snapshots, so physics doesn't have to run at the display rate
+	desired_framerate = boost::any_cast<int>(SettingsManager::Instance().getSetting("physics_rate").data);
+	m_update = (Ogre::Real)(1.0f / (Ogre::Real)desired_framerate);
+
+	StartupPhase phase("physics: create worlds");
+	int shardCount = boost::any_cast<int>(SettingsManager::Instance().getSetting("physics_shards").data);
+	// has to be set before the first world is created
+	NewtonSetMemorySystem(&newtonAlloc, &newtonFree);
+	shards = new WorldShards(Ogre::AxisAlignedBox(Ogre::Vector3(-1000.0,-1000.0,-1000.0), Ogre::Vector3(1000.0,1000.0,1000.0)), shardCount, desired_framerate);
+
 	subscribeToFeed("input_keyboard", boost::bind( &PhysicsImpl::handleKeyEvents, this, _1));
 	subscribeToFeed("create_object", boost::bind( &PhysicsImpl::handleObjectEvents, this, _1));
 	subscribeToFeed("create_terrain", boost::bind( &PhysicsImpl::handleTerrainEvents, this, _1));
+	subscribeToFeed("level_loaded", boost::bind( &PhysicsImpl::handleLevelEvents, this, _1));
+	subscribeToFeed("physics_capture", boost::bind( &PhysicsImpl::handleCaptureEvents, this, _1));
+	subscribeToFeed("physics_restore", boost::bind( &PhysicsImpl::handleRestoreEvents, this, _1));
 }
 void PhysicsImpl::threadWillStop()
 {
+	JobSystem::Instance().wait(simulationJob);
 	Dout << "Time spent working: " << workTime << "s or " << workTime/(workTime + overheadTime)*100 << "%";
 	Dout << "Time spent on overhead: " << overheadTime << "s or " << overheadTime/(workTime + overheadTime)*100 << "%";
 	Dout << "Total runtime: " << (workTime + overheadTime);
 	Dout << "FPS: " << frames / (workTime + overheadTime);
+	Dout << "Bodies in CCD mode: " << ccdPolicy.getCCDBodies() << " (switched on " << ccdPolicy.getEnabledCount() << " times, off " << ccdPolicy.getDisabledCount() << " times)";
+	Dout << "Bodies migrated between " << shards->getShardCount() << " shards: " << shards->getMigrations();
 }
 
 void PhysicsImpl::handleKeyEvents(const DataContainer& data)
 {
 	InputKeyboardEvent ev = boost::any_cast<InputKeyboardEvent>(data.data);
-	if( ev.type == KEY_LEFT && ev.action == BUTTON_PRESSED )
+	if( ev.action != BUTTON_PRESSED || (ev.type != KEY_LEFT && ev.type != KEY_RIGHT) )
 	{
-		worldGraph.nodes.front()->setPosition( Ogre::Vector3(-50.0,-10.0,-20.0) );
+		return;
 	}
-	else if( ev.type == KEY_RIGHT && ev.action == BUTTON_PRESSED )
+	
+	// moves the first dynamic object
+	boost::mutex::scoped_lock lock(worldGraphMutex);
+	entities.query(COMPONENT_BODY, moving);
+	if( moving.empty() || moving.front()->size() == 0 )
 	{
-		worldGraph.nodes.front()->setPosition( Ogre::Vector3(50.0,-10.0,-20.0) );
+		return;
 	}
+	OgreNewt::Body* body = moving.front()->bodies.front();
+	Ogre::Real x = ev.type == KEY_LEFT ? -50.0 : 50.0;
+	body->setPositionOrientation( Ogre::Vector3(x,-10.0,-20.0), body->getOrientation() );
 }
 
 void PhysicsImpl::handleObjectEvents(const DataContainer& data)
@@ -153,9 +327,118 @@ void PhysicsImpl::handleObjectEvents(const DataContainer& data)
 
 void PhysicsImpl::handleTerrainEvents(const DataContainer& data)
 {
-	Terrain obj = boost::any_cast<Terrain>(data.data);
+	TerrainList terrain = boost::any_cast<TerrainList>(data.data);
+	std::map<std::string, ResourceHandle> meshes;
+	
+	// the meshes are loaded in the background, the terrain is built in doStep once they're there
+	boost::shared_ptr<LevelFile> currentLevel;
+	{
+		boost::mutex::scoped_lock lock(levelMutex);
+		currentLevel = level;
+	}
+	
+	boost::mutex::scoped_lock lock(terrainMutex);
+	foreach(const Terrain& obj, *terrain)
+	{
+		const void* blob;
+		size_t blobSize;
+		if(currentLevel && currentLevel->findCollision(obj.specification, obj.scale, LEVEL_COLLISION_TREE, blob, blobSize))
+		{
+			// the collision is in the level already, the mesh isn't needed at all
+			pendingTerrain.push_back( std::make_pair(ResourceHandle(), obj) );
+			continue;
+		}
 		
-	newObject(obj.specification, obj.node.ID, obj.node.pos, obj.node.orient, obj.scale, false);
+		ResourceHandle& mesh = meshes[obj.specification];
+		if(!mesh)
+		{
+			mesh = ResourceManager::Instance().requestResource(obj.specification, RESOURCE_PRIORITY_HIGH);
+		}
+		pendingTerrain.push_back( std::make_pair(mesh, obj) );
+	}
+}
+
+void PhysicsImpl::handleLevelEvents(const DataContainer& data)
+{
+	// newObject locks in the same order
+	boost::mutex::scoped_lock worldLock(worldGraphMutex);
+	boost::mutex::scoped_lock lock(levelMutex);
+	level = boost::any_cast< boost::shared_ptr<LevelFile> >(data.data);
+	// the bodies keep the collisions they use, the caches only serve the new level
+	bakedCollisions.clear();
+	meshCollisions.clear();
+	shards->clearCollisions();
+}
+
+void PhysicsImpl::handleCaptureEvents(const DataContainer& data)
+{
+	PhysicsStatePtr state = boost::any_cast<PhysicsStatePtr>(data.data);
+	boost::mutex::scoped_lock lock(worldGraphMutex);
+	state->capture(entities, worldGraph.time);
+}
+
+void PhysicsImpl::handleRestoreEvents(const DataContainer& data)
+{
+	PhysicsStatePtr state = boost::any_cast<PhysicsStatePtr>(data.data);
+	boost::mutex::scoped_lock lock(worldGraphMutex);
+	size_t missing = state->restore(entities);
+	if( missing > 0 )
+	{
+		Dout << missing << " bodies of the restored physics state don't exist anymore";
+	}
+	// the simulation time goes on, graphics only takes snapshots newer than the last one
+	sceneChanged = true;
+}
+
+OgreNewt::CollisionPtr PhysicsImpl::loadBakedCollision(const std::string& specification, const Ogre::Vector3& scale, level_collision_type type, OgreNewt::World* world)
+{
+	boost::mutex::scoped_lock lock(levelMutex);
+	const void* blob;
+	size_t blobSize;
+	if(!level || !level->findCollision(specification, scale, type, blob, blobSize))
+	{
+		return OgreNewt::CollisionPtr();
+	}
+	
+	OgreNewt::CollisionPtr& col = bakedCollisions[std::make_pair(blob, world)];
+	if(!col)
+	{
+		Ogre::MemoryDataStream stream(const_cast<void*>(blob), blobSize, false);
+		OgreNewt::CollisionSerializer serializer;
+		col = serializer.importCollision(stream, world);
+	}
+	return col;
+}
+
+void PhysicsImpl::createLoadedTerrain()
+{
+	std::vector<Terrain> loaded;
+	{
+		boost::mutex::scoped_lock lock(terrainMutex);
+		if(pendingTerrain.empty())
+		{
+			return;
+		}
+		// a level brings thousands of them, so the list is rebuilt instead of erasing one by one
+		std::vector< std::pair<ResourceHandle, Terrain> > waiting;
+		for(size_t i = 0; i < pendingTerrain.size(); i++)
+		{
+			if(!pendingTerrain[i].first || pendingTerrain[i].first->isReady())
+			{
+				loaded.push_back(pendingTerrain[i].second);
+			}
+			else
+			{
+				waiting.push_back(pendingTerrain[i]);
+			}
+		}
+		pendingTerrain.swap(waiting);
+	}
+	
+	foreach(const Terrain& obj, loaded)
+	{
+		newObject(obj.specification, obj.node.ID, obj.node.pos, obj.node.orient, obj.scale, false);
+	}
 }
 
 /*void PhysicsImpl::handleTransform(OgreNewt::Body* body , const Ogre::Quaternion& orient, const Ogre::Vector3& pos, int threadIndex)
@@ -170,21 +453,31 @@ void PhysicsImpl::handleTerrainEvents(const DataContainer& data)
 
 void PhysicsImpl::newObject(const std::string& specification, int ID, const Ogre::Vector3& pos, const Ogre::Quaternion& orient, Ogre::Vector3 scale, bool dynamic)
 {
-	// look up the identifier and get relevant data - still to add
-	OgreNewt::Node *node = new OgreNewt::Node(ID);
 	boost::mutex::scoped_lock lock(worldGraphMutex);
-	worldGraph.addNode( node );
-		
+	sceneChanged = true;
+	
+	size_t row = entities.add(ID, COMPONENT_TRANSFORM | COMPONENT_SCALE | COMPONENT_SPECIFICATION | (dynamic ? COMPONENT_BODY | COMPONENT_SHARD : 0));
+	Archetype* entity = entities.find(ID, row);
+	entity->transforms[row].pos = pos;
+	entity->transforms[row].orient = orient;
+	entity->scales[row] = scale;
+	entity->specifications[row] = ObjectRegistry::Instance().intern(specification);
 
 	if(dynamic)
 	{
-		// collision primitve - type and size should be determined according to a data file
-		OgreNewt::ConvexCollisionPtr col = OgreNewt::ConvexCollisionPtr(new OgreNewt::CollisionPrimitives::Cylinder(m_World, Ogre::Real(4.9), Ogre::Real(9.8), ID));
+		OgreNewt::World* world = shards->getWorldFor(pos);
+
+		OgreNewt::CollisionPtr col = loadBakedCollision(specification, scale, LEVEL_COLLISION_CONVEX_HULL, world);
+		if(!col)
+		{
+			// collision primitve - type and size should be determined according to a data file
+			col = OgreNewt::CollisionPtr(new OgreNewt::CollisionPrimitives::Cylinder(world, Ogre::Real(4.9), Ogre::Real(9.8), ID));
+		}
 
 		// now we make a new rigid body based on this collision shape.
-		OgreNewt::Body* body = new OgreNewt::Body( m_World, col );
+		OgreNewt::Body* body = new OgreNewt::Body( world, col );
 		Ogre::Vector3 inertia, offset, dir;
-		col->calculateInertialMatrix(inertia, offset);
+		NewtonConvexCollisionCalculateInertialMatrix(col->getNewtonCollision(), &inertia.x, &offset.x);
 		
 		body->setMassMatrix( 10.0, 10.0*inertia );
 		
@@ -193,21 +486,37 @@ void PhysicsImpl::newObject(const std::string& specification, int ID, const Ogre
 		body->setVelocity( Ogre::Vector3(-pos.x,-pos.y,-pos.z) );
 		//body->setLinearDamping(0);
 		
-		body->attachNode( node );	
 		body->setPositionOrientation( pos, orient );
-		body->setContinuousCollisionMode(1);
+		// CCD is only switched on for bodies moving fast enough to tunnel, see CCDPolicy
+		ccdPolicy.evaluate( body, m_update );
 		//body->setCustomTransformCallback( boost::bind( &PhysicsImpl::handleTransform, this, _1, _2, _3, _4 ) );
+		entity->bodies[row] = body;
+		entity->shards[row] = shards->getShardFor(pos);
 	}
 	else
 	{
-		DataContainer data = ResourceManager::Instance().loadResource(specification);
-
-		OgreNewt::CollisionPtr col = OgreNewt::CollisionPtr(new OgreNewt::CollisionPrimitives::TreeCollision(m_World, boost::any_cast<Ogre::MeshPtr>(data.data), true, ID, scale, OgreNewt::CollisionPrimitives::FW_DEFAULT));
-		
-		OgreNewt::Body* body = new OgreNewt::Body(m_World, col);
+		// static geometry lives in every shard; all objects with the same mesh and scale share one
+		// collision per shard, the tree is only built or imported once for each
+		OgreNewt::CollisionPtr col = loadBakedCollision(specification, scale, LEVEL_COLLISION_TREE, shards->getWorld(0));
+		bool baked = true;
+		if(!col)
+		{
+			baked = false;
+			OgreNewt::CollisionPtr& built = meshCollisions[specification + " " + Ogre::StringConverter::toString(scale)];
+			if(!built)
+			{
+				DataContainer data = ResourceManager::Instance().loadResource(specification);
+				built = OgreNewt::CollisionPtr(new OgreNewt::CollisionPrimitives::TreeCollision(shards->getWorld(0), boost::any_cast<Ogre::MeshPtr>(data.data), true, ID, scale, OgreNewt::CollisionPrimitives::FW_DEFAULT));
+			}
+			col = built;
+		}
 		
-		body->attachNode( node );	
-		body->setPositionOrientation( pos, orient );
+		for(int i = 0; i < shards->getShardCount(); i++)
+		{
+			OgreNewt::CollisionPtr shardCol = (i == 0) ? col : (baked ? loadBakedCollision(specification, scale, LEVEL_COLLISION_TREE, shards->getWorld(i)) : shards->getCollision(col, i));
+			OgreNewt::Body* body = new OgreNewt::Body(shards->getWorld(i), shardCol);
+			body->setPositionOrientation( pos, orient );
+		}
 	}
 }
 
@@ -0,0 +1,91 @@
+//
+// C++ Implementation: physicsstate
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "physicsstate.h"
+
+#include <cstring>
+
+void PhysicsState::capture(const EntityStore& entities, double time)
+{
+	this->time = time;
+	bodies.clear();
+	entities.query(COMPONENT_BODY, archetypes);
+	for( size_t i = 0; i < archetypes.size(); i++ )
+	{
+		const Archetype* archetype = archetypes[i];
+		for( size_t row = 0; row < archetype->size(); row++ )
+		{
+			const NewtonBody* body = archetype->bodies[row]->getNewtonBody();
+			bodies.push_back(BodyState());
+			BodyState& state = bodies.back();
+			state.ID = archetype->ids[row];
+			state.sleeping = NewtonBodyGetSleepState(body);
+			state.frozen = NewtonBodyGetFreezeState(body);
+			state.autoSleep = NewtonBodyGetAutoSleep(body);
+			NewtonBodyGetMatrix(body, state.matrix);
+			NewtonBodyGetVelocity(body, state.velocity);
+			NewtonBodyGetOmega(body, state.omega);
+		}
+	}
+}
+
+size_t PhysicsState::restore(EntityStore& entities) const
+{
+	size_t missing = 0;
+	for( size_t i = 0; i < bodies.size(); i++ )
+	{
+		const BodyState& state = bodies[i];
+		size_t row;
+		Archetype* archetype = entities.find(state.ID, row);
+		if( !archetype || !archetype->has(COMPONENT_BODY) )
+		{
+			++missing;
+			continue;
+		}
+		NewtonBody* body = archetype->bodies[row]->getNewtonBody();
+
+		BodyState current;
+		NewtonBodyGetMatrix(body, current.matrix);
+		NewtonBodyGetVelocity(body, current.velocity);
+		NewtonBodyGetOmega(body, current.omega);
+
+		// setting the matrix updates the broadphase, that is most of the cost; bodies at rest skip it
+		bool moved = std::memcmp(current.matrix, state.matrix, sizeof(state.matrix)) != 0;
+		if( moved )
+		{
+			NewtonBodySetMatrix(body, state.matrix);
+			// OgreNewt::Body keeps its own copy of the transform, update it like a step would
+			NewtonSetTransform transformCallback = NewtonBodyGetTransformCallback(body);
+			if( transformCallback )
+				transformCallback(body, state.matrix, 0);
+		}
+		if( moved || std::memcmp(current.velocity, state.velocity, sizeof(state.velocity)) != 0 || std::memcmp(current.omega, state.omega, sizeof(state.omega)) != 0 )
+		{
+			NewtonBodySetVelocity(body, state.velocity);
+			NewtonBodySetOmega(body, state.omega);
+		}
+		// after the velocity, setting it may wake the body up
+		if( NewtonBodyGetFreezeState(body) != state.frozen )
+			NewtonBodySetFreezeState(body, state.frozen);
+		if( NewtonBodyGetAutoSleep(body) != state.autoSleep )
+			NewtonBodySetAutoSleep(body, state.autoSleep);
+		if( NewtonBodyGetSleepState(body) != state.sleeping )
+			NewtonBodySetSleepState(body, state.sleeping);
+	}
+	return missing;
+}
+
+bool PhysicsState::equals(const PhysicsState& other) const
+{
+	// BodyState has no padding, so comparing the bytes compares every field
+	return bodies.size() == other.bodies.size() && (bodies.empty() || std::memcmp(&bodies[0], &other.bodies[0], bodies.size() * sizeof(BodyState)) == 0);
+}
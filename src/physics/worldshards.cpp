@@ -0,0 +1,184 @@
+//
+// C++ Implementation: worldshards
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#include "worldshards.h"
+#include "jobsystem.h"
+
+#include <boost/lexical_cast.hpp>
+
+WorldShards::WorldShards(const Ogre::AxisAlignedBox& bounds, int shardCount, Ogre::Real desiredFps) :
+	migrations(0)
+{
+	if (shardCount < 1) {
+		shardCount = 1;
+	}
+
+	Ogre::Vector3 min = bounds.getMinimum();
+	Ogre::Vector3 max = bounds.getMaximum();
+	Ogre::Real width = (max.x - min.x) / shardCount;
+	// each world reaches a bit into its neighbours, so bodies don't leave it before they are migrated
+	Ogre::Real margin = width * 0.1f;
+	hysteresis = margin * 0.25f;
+
+	for (int i = 0; i < shardCount; i++) {
+		Shard shard;
+
+		if (shardCount == 1) {
+			shard.world = new OgreNewt::World();
+		}
+		else {
+			shard.world = new OgreNewt::World(desiredFps, 10, "shard" + boost::lexical_cast<std::string>(i));
+		}
+
+		shard.minX = min.x + i * width;
+		shard.maxX = min.x + (i + 1) * width;
+		shard.world->setWorldSize(Ogre::Vector3(shard.minX - margin, min.y, min.z), Ogre::Vector3(shard.maxX + margin, max.y, max.z));
+		shards.push_back(shard);
+	}
+}
+
+WorldShards::~WorldShards()
+{
+	for (std::vector<Shard>::iterator iter = shards.begin(); iter != shards.end(); ++iter) {
+		delete iter->world;
+	}
+}
+
+int WorldShards::getShardFor(const Ogre::Vector3& pos) const
+{
+	for (int i = 0; i < (int)shards.size(); i++) {
+		if (pos.x < shards[i].maxX) {
+			return i;
+		}
+	}
+
+	return shards.size() - 1;
+}
+
+/** steps one world; a bound member function with its arguments is too big for boost::function
+ * to keep without allocating, this isn't
+ **/
+struct StepWorld
+{
+	OgreNewt::World* world;
+	Ogre::Real timestep;
+
+	void operator()() const {
+		world->update(timestep);
+	}
+};
+
+void WorldShards::update(Ogre::Real timestep, EntityStore& entities)
+{
+	if (shards.size() == 1) {
+		shards.front().world->update(timestep);
+		return;
+	}
+
+	JobCounter stepped;
+
+	for (std::vector<Shard>::iterator iter = shards.begin(); iter != shards.end(); ++iter) {
+		StepWorld step = { iter->world, timestep };
+		JobSystem::Instance().submit(step, &stepped);
+	}
+
+	JobSystem::Instance().wait(stepped);
+	migrateBodies(entities);
+}
+
+void WorldShards::migrateBodies(EntityStore& entities)
+{
+	entities.query(COMPONENT_BODY | COMPONENT_SHARD, sharded);
+
+	for (std::vector<Archetype*>::iterator archetype = sharded.begin(); archetype != sharded.end(); ++archetype) {
+		std::vector<OgreNewt::Body*>& bodies = (*archetype)->bodies;
+		std::vector<int>& bodyShards = (*archetype)->shards;
+
+		for (size_t i = 0; i < bodies.size(); i++) {
+			Ogre::Real x = bodies[i]->getPosition().x;
+			const Shard& current = shards[bodyShards[i]];
+
+			if (x < current.minX - hysteresis || x > current.maxX + hysteresis) {
+				migrate(bodies[i], bodyShards[i], getShardFor(bodies[i]->getPosition()));
+			}
+		}
+	}
+}
+
+void WorldShards::migrate(OgreNewt::Body*& body, int& shard, int target)
+{
+	OgreNewt::World* world = shards[target].world;
+
+	Ogre::Vector3 pos, inertia;
+	Ogre::Quaternion orient;
+	Ogre::Real mass;
+	body->getPositionOrientation(pos, orient);
+	body->getMassMatrix(mass, inertia);
+
+	OgreNewt::Body* moved = new OgreNewt::Body(world, getCollision(body->getCollision(), target));
+	moved->setMassMatrix(mass, inertia);
+	// all dynamic bodies created by PhysicsImpl use the standard gravity callback
+	moved->setStandardForceCallback();
+	moved->setPositionOrientation(pos, orient);
+	moved->setVelocity(body->getVelocity());
+	moved->setOmega(body->getOmega());
+	moved->setContinuousCollisionMode(NewtonBodyGetContinuousCollisionMode(body->getNewtonBody()));
+
+	delete body;
+
+	body = moved;
+	shard = target;
+	migrations++;
+}
+
+OgreNewt::CollisionPtr WorldShards::getCollision(const OgreNewt::CollisionPtr& collision, int shard)
+{
+	OgreNewt::World* world = shards[shard].world;
+	if (collision->getWorld() == world) {
+		return collision;
+	}
+
+	boost::shared_ptr<CollisionFamily>& family = families[collision->getNewtonCollision()];
+	if (!family) {
+		family.reset(new CollisionFamily);
+		family->instances.resize(shards.size());
+		for (size_t i = 0; i < shards.size(); i++) {
+			if (shards[i].world == collision->getWorld()) {
+				family->instances[i] = collision;
+			}
+		}
+	}
+
+	OgreNewt::CollisionPtr& instance = family->instances[shard];
+	if (!instance) {
+		if (family->blob.empty()) {
+			NewtonCollisionSerialize(collision->getWorld()->getNewtonWorld(), collision->getNewtonCollision(), &WorldShards::serializeCallback, &family->blob);
+		}
+		Ogre::MemoryDataStream stream(&family->blob[0], family->blob.size(), false);
+		OgreNewt::CollisionSerializer serializer;
+		instance = serializer.importCollision(stream, world);
+		families[instance->getNewtonCollision()] = family;
+	}
+	return instance;
+}
+
+void WorldShards::clearCollisions()
+{
+	families.clear();
+}
+
+void _CDECL WorldShards::serializeCallback(void* serializeHandle, const void* buffer, int size)
+{
+	std::vector<char>* dest = static_cast<std::vector<char>*>(serializeHandle);
+	const char* data = static_cast<const char*>(buffer);
+	dest->insert(dest->end(), data, data + size);
+}
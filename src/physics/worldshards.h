@@ -0,0 +1,95 @@
+//
+// C++ Interface: worldshards
+//
+// Description: Splits the simulated space into regions along the x axis, each
+// simulated by its own OgreNewt::World, so large maps can use more than one
+// core for the Newton update.
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#ifndef WORLDSHARDS_H
+#define WORLDSHARDS_H
+
+#include "Ogre.h"
+#include "OgreNewt.h"
+#include "entitystore.h"
+
+#include <vector>
+#include <map>
+#include <boost/shared_ptr.hpp>
+
+/** Owns one or more OgreNewt::World instances covering adjacent slices of the level.
+ * With a single shard update() steps the world in the calling thread, which is exactly
+ * the old single-world behaviour.
+ * With more shards every world is stepped as a job on the JobSystem; after each step dynamic
+ * bodies which left their slice are recreated in the neighbouring world. Which shard a body
+ * is in is kept in the COMPONENT_SHARD of its entity.
+ * Bodies in different shards don't collide with each other until one of them migrates,
+ * so slices should be wide compared to the objects living in them.
+ **/
+class WorldShards
+{
+	public:
+		WorldShards(const Ogre::AxisAlignedBox& bounds, int shardCount, Ogre::Real desiredFps);
+		~WorldShards();
+
+		int getShardCount() const { return shards.size(); }
+		OgreNewt::World* getWorld(int shard) { return shards[shard].world; }
+		/** returns the shard whose slice contains pos, positions outside the level are clamped **/
+		int getShardFor(const Ogre::Vector3& pos) const;
+		OgreNewt::World* getWorldFor(const Ogre::Vector3& pos) { return getWorld(getShardFor(pos)); }
+
+		/** steps all shards by timestep (in parallel if there is more than one), then migrates
+		 * the bodies of entities which have COMPONENT_BODY and COMPONENT_SHARD
+		 **/
+		void update(Ogre::Real timestep, EntityStore& entities);
+
+		/** Returns the instance of collision in the world of shard. A Newton collision belongs to one
+		 * world, so every shard needs its own: collision is serialized once, going through the
+		 * serializer so any shape type works, and each shard imports it once. Later calls with
+		 * collision or any of its copies return the same instances.
+		 * They are kept until clearCollisions(), the bodies using them keep their own references.
+		 **/
+		OgreNewt::CollisionPtr getCollision(const OgreNewt::CollisionPtr& collision, int shard);
+		void clearCollisions();
+
+		int getMigrations() const { return migrations; }
+
+	private:
+		struct Shard
+		{
+			OgreNewt::World* world;
+			Ogre::Real minX, maxX;
+		};
+
+		void migrateBodies(EntityStore& entities);
+		/** recreates body in shard target, replacing both **/
+		void migrate(OgreNewt::Body*& body, int& shard, int target);
+		static void _CDECL serializeCallback(void* serializeHandle, const void* buffer, int size);
+
+		/** one collision and its copies in the other shards **/
+		struct CollisionFamily
+		{
+			/** the serialized collision, filled when the first copy is needed **/
+			std::vector<char> blob;
+			/** the instance in each shard, null until it is needed **/
+			std::vector<OgreNewt::CollisionPtr> instances;
+		};
+		typedef std::map< const NewtonCollision*, boost::shared_ptr<CollisionFamily> > CollisionFamilies;
+		/** every instance of a family maps to it **/
+		CollisionFamilies families;
+
+		std::vector<Shard> shards;
+		/** reused by migrateBodies **/
+		std::vector<Archetype*> sharded;
+
+		Ogre::Real hysteresis;
+		int migrations;
+};
+
+#endif
@@ -0,0 +1,131 @@
+//
+// C++ Implementation: profiler
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <boost/lexical_cast.hpp>
+
+const size_t Profiler::CAPACITY;
+
+/** the ring of the calling thread, registered on its first zone **/
+static __thread void* threadBuffer = 0;
+
+Profiler::Profiler() : started(monotonicTime())
+{
+}
+
+Profiler::~Profiler()
+{
+	for(size_t i = 0; i < buffers.size(); i++)
+	{
+		delete buffers[i];
+	}
+}
+
+Profiler::ThreadBuffer* Profiler::getBuffer()
+{
+	if(!threadBuffer)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		ThreadBuffer* buffer = new ThreadBuffer(buffers.size() + 1);
+		buffers.push_back(buffer);
+		threadBuffer = buffer;
+	}
+	return static_cast<ThreadBuffer*>(threadBuffer);
+}
+
+void Profiler::addZone(const char* name, double start, double end)
+{
+	ThreadBuffer* buffer = getBuffer();
+	size_t index = buffer->written.load(std::memory_order_relaxed);
+	Zone& zone = buffer->zones[index % CAPACITY];
+
+	// a reader which sees any of the new values also sees begun, see writeChromeTrace
+	buffer->begun.store(index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	zone.name.store(name, std::memory_order_relaxed);
+	zone.start.store(start, std::memory_order_relaxed);
+	zone.end.store(end, std::memory_order_relaxed);
+
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::nameThread(const std::string& name)
+{
+	ThreadBuffer* buffer = getBuffer();
+	boost::mutex::scoped_lock lock(mutex);
+	buffer->name = name;
+}
+
+/** JSON string literal of text, zone and thread names are plain identifiers but may contain quotes **/
+static std::string quote(const std::string& text)
+{
+	std::string quoted = "\"";
+	for(std::string::const_iterator it = text.begin(); it != text.end(); ++it)
+	{
+		if(*it == '"' || *it == '\\')
+		{
+			quoted += '\\';
+		}
+		quoted += *it;
+	}
+	return quoted + "\"";
+}
+
+bool Profiler::writeChromeTrace(const std::string& path)
+{
+	std::ofstream file(path.c_str());
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	file << "{\"traceEvents\":[";
+
+	boost::mutex::scoped_lock lock(mutex);
+	bool first = true;
+
+	for(size_t i = 0; i < buffers.size(); i++)
+	{
+		ThreadBuffer* buffer = buffers[i];
+		std::string name = buffer->name.empty() ? "thread " + boost::lexical_cast<std::string>(buffer->id) : buffer->name;
+		file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":" << quote(name) << "}}";
+		first = false;
+
+		size_t written = buffer->written.load(std::memory_order_acquire);
+		size_t oldest = written > CAPACITY ? written - CAPACITY : 0;
+
+		std::vector<const char*> names;
+		std::vector<double> starts, ends;
+		for(size_t index = oldest; index < written; index++)
+		{
+			const Zone& zone = buffer->zones[index % CAPACITY];
+			names.push_back(zone.name.load(std::memory_order_relaxed));
+			starts.push_back(zone.start.load(std::memory_order_relaxed));
+			ends.push_back(zone.end.load(std::memory_order_relaxed));
+		}
+
+		// the thread kept recording while we copied, slots it started writing since may be torn
+		std::atomic_thread_fence(std::memory_order_acquire);
+		size_t begun = buffer->begun.load(std::memory_order_relaxed);
+		size_t valid = begun > CAPACITY ? begun - CAPACITY : 0;
+
+		for(size_t index = std::max(oldest, valid); index < written; index++)
+		{
+			size_t k = index - oldest;
+			// complete events, in microseconds
+			file << ",\n{\"name\":" << quote(names[k]) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+				<< ",\"ts\":" << (starts[k] - started) * 1000000.0 << ",\"dur\":" << (ends[k] - starts[k]) * 1000000.0 << "}";
+		}
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
@@ -1,7 +1,7 @@
 //
 // C++ Implementation: resourcemanager
 //
-// Description: 
+// Description:
 //
 //
 // Author:  <>, (C) 2009
@@ -11,22 +11,139 @@
 //
 #include "resourcemanager.h"
 #include "Ogre.h"
+#include <boost/bind.hpp>
 
 
+bool ResourceRequest::isReady() const
+{
+	boost::mutex::scoped_lock lock(mutex);
+	return ready;
+}
+
+DataContainer ResourceRequest::wait()
+{
+	boost::mutex::scoped_lock lock(mutex);
+	while(!ready)
+	{
+		loaded.wait(lock);
+	}
+	return data;
+}
+
+void ResourceRequest::complete(const DataContainer& result)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		data = result;
+		ready = true;
+	}
+	loaded.notify_all();
+}
+
+
+ResourceManager::ResourceManager() : sequence(0), stopping(false)
+{
+	for(int i = 0; i < WORKER_COUNT; i++)
+	{
+		workers.create_thread(boost::bind(&ResourceManager::workerLoop, this));
+	}
+}
+
+ResourceManager::~ResourceManager()
+{
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	workers.join_all();
+}
+
+ResourceHandle ResourceManager::requestResource(const std::string& name, int priority)
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	std::map<std::string, ResourceHandle>::iterator it = resources.find(name);
+	if(it != resources.end() && it->second->started)
+	{
+		return it->second;
+	}
+
+	ResourceHandle request;
+	if(it != resources.end())
+	{
+		request = it->second;
+	}
+	else
+	{
+		request = ResourceHandle(new ResourceRequest(name));
+		resources[name] = request;
+	}
+
+	// a request which is still queued is just queued again, the entry with the lower priority is skipped later
+	QueueEntry entry;
+	entry.request = request;
+	entry.priority = priority;
+	entry.sequence = sequence++;
+	queue.push(entry);
+
+	workAvailable.notify_one();
+	return request;
+}
+
 DataContainer ResourceManager::loadResource(const std::string& name)
 {
-	if(resources.find(name) == resources.end())
+	return requestResource(name, RESOURCE_PRIORITY_HIGH)->wait();
+}
+
+void ResourceManager::workerLoop()
+{
+	while(true)
 	{
-		if(name.find("mesh") != std::string::npos)
+		ResourceHandle request;
 		{
-			std::pair<Ogre::ResourcePtr, bool> pair = Ogre::MeshManager::getSingleton().createOrRetrieve(name, "General");
-			Ogre::MeshPtr mesh = pair.first;
-			if(! pair.second)
+			boost::mutex::scoped_lock lock(mutex);
+			while(!stopping && queue.empty())
+			{
+				workAvailable.wait(lock);
+			}
+			if(stopping)
+			{
+				return;
+			}
+
+			request = queue.top().request;
+			queue.pop();
+
+			if(request->started)
 			{
-				Derr << "Ressource " << name << " couldn't be loaded";
+				continue;
 			}
-			resources[name] = DataContainer(mesh);
+			request->started = true;
+		}
+
+		request->complete(load(request->getName()));
+		InformationManager::Instance()->postDataToFeed("resource_loaded", DataContainer(request->getName()));
+	}
+}
+
+DataContainer ResourceManager::load(const std::string& name)
+{
+	if(name.find("mesh") != std::string::npos)
+	{
+		Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().createOrRetrieve(name, "General").first;
+		try
+		{
+			// only reads the file, creating the hardware buffers is left to whoever uses the mesh first
+			mesh->prepare();
 		}
+		catch(Ogre::Exception& ex)
+		{
+			Derr << "Ressource " << name << " couldn't be loaded: " << ex.getFullDescription();
+		}
+		return DataContainer(mesh);
 	}
-	return DataContainer(resources[name]);
-}
\ No newline at end of file
+
+	Derr << "Don't know how to load ressource " << name;
+	return DataContainer();
+}
@@ -1,24 +1,225 @@
 #include "FeedDataTypes.h"
+#include "levelfile.h"
+#include "OgreDefaultHardwareBufferManager.h"
+#include "OgreConfigFile.h"
 #include "boost/filesystem.hpp"
 #include <boost/filesystem/fstream.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <iostream>
+#include <sstream>
+#include <set>
 
 namespace fs = boost::filesystem;
 namespace ar = boost::archive;
 
-int main()
+/** Level compiler: turns a text level into the binary format the game loads, with the
+ * collision of every mesh already built.
+ * A text level has one object per line:
+ *   [spawn] specification  pos.x pos.y pos.z  orient.w orient.x orient.y orient.z  scale.x scale.y scale.z
+ * Objects are static terrain unless the line starts with spawn, then they are dynamic.
+ * Empty lines and lines starting with # are ignored. Single Terrains written by the old
+ * text_oarchive serializer are accepted as well.
+ **/
+static bool readTextLevel(const std::string& path, std::vector<Terrain>& statics, std::vector<Terrain>& spawns)
 {
-	OgreNewt::Node node;
-	std::cout << sizeof(node) << std::endl;
-	Terrain terrain;
-	terrain.node.pos = Ogre::Vector3(1,2,3);
-	terrain.scale = Ogre::Vector3(2.0, 2.0, 2.0);
-	terrain.node.ID = -1;
-	terrain.specification = "playground.mesh";
-	
-	fs::ofstream file("Media/custom/terrain");
-	ar::text_oarchive oa(file);
-	oa << terrain;
-}
\ No newline at end of file
+	fs::ifstream file(path);
+	if(!file)
+	{
+		std::cerr << "Can't open " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	std::getline(file, line);
+	if(line.find("serialization::archive") != std::string::npos)
+	{
+		file.seekg(0);
+		Terrain terrain;
+		ar::text_iarchive ia(file);
+		ia >> terrain;
+		statics.push_back(terrain);
+		return true;
+	}
+
+	int lineNumber = 1;
+	do
+	{
+		std::istringstream fields(line);
+		Terrain terrain;
+		Ogre::Quaternion& orient = terrain.node.orient;
+
+		if(!(fields >> terrain.specification) || terrain.specification[0] == '#')
+		{
+			continue;
+		}
+		bool spawn = terrain.specification == "spawn";
+		if(spawn)
+		{
+			fields >> terrain.specification;
+		}
+		if(!(fields >> terrain.node.pos.x >> terrain.node.pos.y >> terrain.node.pos.z
+			>> orient.w >> orient.x >> orient.y >> orient.z
+			>> terrain.scale.x >> terrain.scale.y >> terrain.scale.z))
+		{
+			std::cerr << path << ":" << lineNumber << ": expected specification, position, orientation and scale" << std::endl;
+			return false;
+		}
+		(spawn ? spawns : statics).push_back(terrain);
+	}
+	while(++lineNumber && std::getline(file, line));
+
+	return true;
+}
+
+/** Ogre without a render system: enough to load meshes into system memory **/
+static void setupOgre(const std::string& resourceConfig)
+{
+	new Ogre::Root("", "", "serializer.log");
+	new Ogre::DefaultHardwareBufferManager();
+
+	// the same locations the game uses, only indexed, no scripts are parsed
+	Ogre::ConfigFile cf;
+	cf.load(resourceConfig);
+	Ogre::ConfigFile::SectionIterator seci = cf.getSectionIterator();
+	while(seci.hasMoreElements())
+	{
+		std::string secName = seci.peekNextKey();
+		Ogre::ConfigFile::SettingsMultiMap *settings = seci.getNext();
+		for(Ogre::ConfigFile::SettingsMultiMap::iterator i = settings->begin(); i != settings->end(); ++i)
+		{
+			Ogre::ResourceGroupManager::getSingleton().addResourceLocation(i->second, i->first, secName);
+		}
+	}
+}
+
+static void _CDECL appendBlob(void* serializeHandle, const void* buffer, int size)
+{
+	std::vector<char>* blob = static_cast<std::vector<char>*>(serializeHandle);
+	const char* data = static_cast<const char*>(buffer);
+	blob->insert(blob->end(), data, data + size);
+}
+
+static std::vector<char> serializeCollision(OgreNewt::World& world, const OgreNewt::CollisionPtr& collision)
+{
+	std::vector<char> blob;
+	NewtonCollisionSerialize(world.getNewtonWorld(), collision->getNewtonCollision(), &appendBlob, &blob);
+	return blob;
+}
+
+static void collectVertices(const Ogre::MeshPtr& mesh, const Ogre::Vector3& scale, std::vector<Ogre::Vector3>& vertices)
+{
+	bool sharedAdded = false;
+	for(unsigned short i = 0; i < mesh->getNumSubMeshes(); i++)
+	{
+		Ogre::SubMesh* sub = mesh->getSubMesh(i);
+		if(sub->useSharedVertices && sharedAdded)
+		{
+			continue;
+		}
+		sharedAdded = sharedAdded || sub->useSharedVertices;
+
+		Ogre::VertexData* data = sub->useSharedVertices ? mesh->sharedVertexData : sub->vertexData;
+		const Ogre::VertexElement* element = data->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
+		Ogre::HardwareVertexBufferSharedPtr buffer = data->vertexBufferBinding->getBuffer(element->getSource());
+
+		unsigned char* vertex = static_cast<unsigned char*>(buffer->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+		vertex += data->vertexStart * buffer->getVertexSize();
+		for(size_t j = 0; j < data->vertexCount; j++, vertex += buffer->getVertexSize())
+		{
+			float* pos;
+			element->baseVertexPointerToElement(vertex, &pos);
+			vertices.push_back(Ogre::Vector3(pos[0], pos[1], pos[2]) * scale);
+		}
+		buffer->unlock();
+	}
+}
+
+/** builds every distinct mesh and scale once: tree collisions for static objects, convex hulls for spawns **/
+static bool bakeCollisions(const std::vector<Terrain>& objects, level_collision_type type, OgreNewt::World& world, LevelWriter& level)
+{
+	std::set< std::pair<std::string, std::vector<float> > > baked;
+
+	for(std::vector<Terrain>::const_iterator it = objects.begin(); it != objects.end(); ++it)
+	{
+		std::vector<float> scale(it->scale.ptr(), it->scale.ptr() + 3);
+		if(!baked.insert(std::make_pair(it->specification, scale)).second)
+		{
+			continue;
+		}
+
+		Ogre::MeshPtr mesh;
+		try
+		{
+			mesh = Ogre::MeshManager::getSingleton().load(it->specification, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+		}
+		catch(Ogre::Exception& ex)
+		{
+			std::cerr << "Can't load " << it->specification << ": " << ex.getDescription() << std::endl;
+			return false;
+		}
+
+		OgreNewt::CollisionPtr collision;
+		if(type == LEVEL_COLLISION_TREE)
+		{
+			collision = OgreNewt::CollisionPtr(new OgreNewt::CollisionPrimitives::TreeCollision(&world, mesh, true, 0, it->scale, OgreNewt::CollisionPrimitives::FW_DEFAULT));
+		}
+		else
+		{
+			std::vector<Ogre::Vector3> vertices;
+			collectVertices(mesh, it->scale, vertices);
+			if(vertices.empty())
+			{
+				std::cerr << it->specification << " has no vertices" << std::endl;
+				return false;
+			}
+			collision = OgreNewt::CollisionPtr(new OgreNewt::CollisionPrimitives::ConvexHull(&world, &vertices[0], vertices.size(), 0, Ogre::Quaternion::IDENTITY, Ogre::Vector3::ZERO, 0.0));
+		}
+
+		level.addCollision(it->specification, it->scale, type, serializeCollision(world, collision));
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	// serializer [text level] [binary level] [resources.cfg]
+	std::string input = argc > 1 ? argv[1] : "Media/custom/simple.level";
+	std::string output = argc > 2 ? argv[2] : "Media/custom/level";
+	std::string resourceConfig = argc > 3 ? argv[3] : "resources.cfg";
+
+	std::vector<Terrain> statics, spawns;
+	if(!readTextLevel(input, statics, spawns))
+	{
+		return EXIT_FAILURE;
+	}
+
+	LevelWriter level;
+	for(std::vector<Terrain>::const_iterator it = statics.begin(); it != statics.end(); ++it)
+	{
+		level.addPlacement(*it);
+	}
+	for(std::vector<Terrain>::const_iterator it = spawns.begin(); it != spawns.end(); ++it)
+	{
+		level.addSpawn(*it);
+	}
+
+	setupOgre(resourceConfig);
+	{
+		OgreNewt::World world;
+		if(!bakeCollisions(statics, LEVEL_COLLISION_TREE, world, level) || !bakeCollisions(spawns, LEVEL_COLLISION_CONVEX_HULL, world, level))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(!level.write(output))
+	{
+		std::cerr << "Can't write " << output << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "Compiled " << level.getPlacementCount() << " static objects, " << level.getSpawnCount() << " spawns and "
+		<< level.getCollisionCount() << " collisions from " << input << " into " << output << std::endl;
+	return EXIT_SUCCESS;
+}
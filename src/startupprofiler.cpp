@@ -0,0 +1,71 @@
+//
+// C++ Implementation: startupprofiler
+//
+// Description:
+//
+//
+// Author:  <>, (C) 2009
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "startupprofiler.h"
+#include "timer.h"
+#include <taskengine/taskengine.h>
+#include <algorithm>
+#include <sstream>
+
+static bool startsEarlier(const std::pair<double, std::string>& a, const std::pair<double, std::string>& b)
+{
+	return a.first < b.first;
+}
+
+StartupProfiler::StartupProfiler() : started(monotonicTime()), reported(false)
+{
+}
+
+double StartupProfiler::now() const
+{
+	return monotonicTime() - started;
+}
+
+void StartupProfiler::addPhase(const std::string& name, double start, double duration)
+{
+	Phase phase;
+	phase.name = name;
+	phase.start = start;
+	phase.duration = duration;
+
+	boost::mutex::scoped_lock lock(mutex);
+	phases.push_back(phase);
+}
+
+void StartupProfiler::report()
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	if(reported)
+		return;
+	reported = true;
+
+	double total = now();
+	double serial = 0.0;
+	std::vector< std::pair<double, std::string> > lines;
+
+	for(std::vector<Phase>::const_iterator it = phases.begin(); it != phases.end(); ++it)
+	{
+		std::ostringstream line;
+		line.setf(std::ios::fixed);
+		line.precision(1);
+		line << "  " << it->start * 1000.0 << " ms  +" << it->duration * 1000.0 << " ms  " << it->name;
+		lines.push_back(std::make_pair(it->start, line.str()));
+		serial += it->duration;
+	}
+	std::sort(lines.begin(), lines.end(), startsEarlier);
+
+	Dout << "Startup took " << total * 1000.0 << " ms, the timed phases sum up to " << serial * 1000.0 << " ms:";
+	for(std::vector< std::pair<double, std::string> >::const_iterator it = lines.begin(); it != lines.end(); ++it)
+	{
+		Dout << it->second;
+	}
+}